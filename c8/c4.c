@@ -32,7 +32,8 @@ int *e, *le,  // current/line position in emitted code
     loc,      // local variable offset
     line,     // current line number
     src,      // print source and assembly flag
-    dbg;      // print executed instructions
+    dbg,      // print executed instructions
+    bmp;      // bump heap: malloc never recycles, free is a no-op
 
 // identifier
 struct ident_s {
@@ -76,6 +77,9 @@ enum {
 // types
 enum { CHAR, INT, PTR = 256, PTR2 = 512 };
 
+// heap: chunks of HeapSz bytes, blocks up to MinSz << (Classes - 1) bytes are recycled in size classes
+enum { HeapSz = 262144, MinSz = 8, Classes = 13 };
+
 char *e2s(int x) {
   char *str;
   if (0 <= x && x < 32) {
@@ -482,13 +486,16 @@ int main(int argc, char **argv) {
   struct ident_s *idmain;
   struct member_s *m;
   int *pc, *sp, *bp, a, cycle; // vm registers
-  int i, *pp; // temps
+  int *hc, *fl, *hq; // heap chunk chain, size class free lists
+  char *hp, *he;     // heap bump position and end of current chunk
+  int i, *pp, sz;    // temps
   char *t;
 
   --argc; ++argv;
   if (argc > 0 && **argv == '-' && (*argv)[1] == 's') { src = 1; --argc; ++argv; }
   if (argc > 0 && **argv == '-' && (*argv)[1] == 'd') { dbg = 1; --argc; ++argv; }
-  if (argc < 1) { printf("usage: c4 [-s] [-d] [-v] file ...\n"); return -1; }
+  if (argc > 0 && **argv == '-' && (*argv)[1] == 'f') { bmp = 1; --argc; ++argv; }
+  if (argc < 1) { printf("usage: c4 [-s] [-d] [-f] file ...\n"); return -1; }
 
   fn = *argv;
   fd = open(fn, 0); if (fd < 0) { printf("could not open(%s)\n", *argv); return -1; }
@@ -704,6 +711,10 @@ int main(int argc, char **argv) {
   // call exit if main returns
   *++e = PUSH; pp = e;
   *++e = EXIT;
+  // setup heap
+  fl = malloc(Classes * sizeof(int)); if (!fl) { printf("could not malloc(%d) free lists\n", Classes * sizeof(int)); return -1; }
+  memset(fl, 0, Classes * sizeof(int));
+  hc = 0; hp = he = 0;
   // setup stack
   bp = sp = (int *)((int)sp + poolsz);
   *--sp = argc;
@@ -757,12 +768,46 @@ int main(int argc, char **argv) {
     else if (i == CLOSE)  a = close(*sp);
     else if (i == PRINTF) { pp = sp + pc[1]; a = printf((char *)pp[-1], pp[-2], pp[-3], pp[-4], pp[-5], pp[-6], pp[-7], pp[-8]); }
     else if (i == SCANF)  { pp = sp + pc[1]; a = scanf((char *)pp[-1], pp[-2], pp[-3], pp[-4], pp[-5], pp[-6], pp[-7], pp[-8]); }
-    else if (i == MALLOC) a = (int)malloc(*sp);
-    else if (i == FREE)   { a = *sp; free((void *)a); }
+    else if (i == MALLOC) { // small blocks from their size class free list or the current chunk, big blocks get a chunk of their own
+      sz = *sp; a = i = 0;
+      while (i < Classes && (MinSz << i) < sz) ++i;
+      if (!bmp && i < Classes && fl[i]) { a = fl[i]; fl[i] = *(int *)a; }
+      else if (sz >= 0) {
+        if (i < Classes && !bmp) sz = MinSz << i;
+        sz = (sz + sizeof(int) - 1) & -sizeof(int);
+        if (!bmp) sz = sz + sizeof(int); // size class header
+        if (i == Classes || hp + sz > he) { // new chunk linked into the chain
+          if (i == Classes) hq = malloc(sz + sizeof(int)); else hq = malloc(HeapSz);
+          if (hq) {
+            *hq = (int)hc; hc = hq;
+            if (i == Classes) a = (int)(hq + 1); else { hp = (char *)(hq + 1); he = (char *)hq + HeapSz; }
+          }
+        }
+        if (i < Classes && hp + sz <= he) { a = (int)hp; hp = hp + sz; }
+        if (a && !bmp) { *(int *)a = i; a = a + sizeof(int); }
+      }
+    }
+    else if (i == FREE)   { // small blocks go back to their free list, big chunks are unlinked and released
+      a = *sp;
+      if (a && !bmp) {
+        hq = (int *)a - 1; i = *hq;
+        if (i >= 0 && i < Classes) { *(int *)a = fl[i]; fl[i] = a; }
+        else if (i == Classes) {
+          --hq; pp = (int *)&hc;
+          while (*pp && *pp != (int)hq) pp = (int *)*pp;
+          if (*pp) { *pp = *hq; free(hq); }
+        }
+      }
+    }
     else if (i == MEMSET) a = (int)memset((char *)sp[2], sp[1], *sp);
     else if (i == MEMCMP) a = memcmp((char *)sp[2], (char *)sp[1], *sp);
     else if (i == MEMCPY) a = (int)memcpy((char *)sp[2], (char *)sp[1], *sp);
-    else if (i == EXIT)   { if (dbg) printf("exit(%d) cycle = %d\n", *sp, cycle); return *sp; }
+    else if (i == EXIT)   {
+      if (dbg) printf("exit(%d) cycle = %d\n", *sp, cycle);
+      while (hc) { hq = hc; hc = (int *)*hc; free(hq); } // release the whole heap
+      free(fl);
+      return *sp;
+    }
 
     else { printf("unknown instruction %d! cycle = %d\n", i, cycle); return -1; }
   }
@@ -1,5 +1,10 @@
 // c8.c - C in eight functions
 //   no enum name
+//   no implicit conversion of long long or double function arguments
+//   preprocessor: #include "file" (guarded headers once), object-like #define, #if constant, #ifdef, #ifndef, #else, #endif
+//   -b sandbox: open, close and scanf refused, read and write on fds 0-2 only, memory accesses wrap within the sandbox
+//   -f bump heap for short-lived programs: free is a no-op
+//   -p file: sample the call stack every ProfN cycles, write collapsed stacks for flamegraph.pl
 
 // Based on c4.c - C in four functions
 // Written by Robert Swierczek
@@ -13,25 +18,34 @@
 char *p, *lp, *tp, // current/line/token position in source code
      *d, *data,    // current data pointer
      *ops,         // opcodes
-     *fn;          // filename
+     *fn,          // filename
+     *prof;        // profile output file
 
 int *e, *le, *code, // current/line position in emitted code
     *stack,         // 
+    *tsize,         // array (indexed by type) of type sizes
     *sym,           // symbol table (simple list of identifiers)
     *id, *ast,      // currently parsed identifier
     *n,             // current node in abstract syntax tree
     *idmain,        // 
+    *inp, *inb,     // input stack (saved p, lp, line and fn of including files and expanding macros, and the macro) and its base
+    *inc,           // included headers (list of next, path, path length, guard: identifier, -1 until its #ifndef is read, 0 if unguarded)
+    pre,            // pending preprocessor directive ('d'efine, 'i'fdef, 'n'ifndef) or group to skip ('s' up to #else or #endif, 'e' up to #endif)
     tk,             // current token
     ival,           // current token value
     ty,             // current expression type
+    fty,            // current function return type
+    ws,             // stack slots per long long or double
     line,           // current line number
     src,            // print source and assembly flag
-    dbg;            // print executed instructions
+    dbg,            // print executed instructions
+    sbx,            // sandbox: data, heap and stack in one region, all memory accesses masked into it
+    bmp;            // bump heap: malloc never recycles, free is a no-op
 
 // tokens and classes (operators last and in precedence order)
 enum {
-  Num = 128, Fun, Sys, Global, Local, Id, Load, Enter,
-  Char, Else, Enum, If, Int, Return, Sizeof, While,
+  Num = 128, Fun, Sys, Global, Local, Def, Id, Load, Enter, Dbl, Cast, Wide,
+  Char, Int, Long, Double, Else, Enum, If, Return, Sizeof, While,
   Assign, Cond, Lor, Land, Or, Xor, And, Eq, Ne, Lt, Gt, Le, Ge, Shl, Shr, Add, Sub, Mul, Div, Mod, Inc, Dec, Bracket
 };
 
@@ -39,23 +53,41 @@ enum {
 enum {
   IMM, LEA, JMP, JSR, BZ, BNZ, ENTER, ADJ, LEAVE, LI, LC, SI, SC, PUSH,
   OR, XOR, AND, EQ, NE, LT, GT, LE, GE, SHL, SHR, ADD, SUB, MUL, DIV, MOD, 
+  LDL, LDD, STL, STD, PSHL, PSHD, ITL, ITF, LTI, LTF, FTI, FTL,
+  LOR, LXOR, LAND, LEQ, LNE, LLT, LGT, LLE, LGE, LSHL, LSHR, LADD, LSUB, LMUL, LDIV, LMOD,
+  FEQ, FNE, FLT, FGT, FLE, FGE, FADD, FSUB, FMUL, FDIV,
   OPEN, READ, WRITE, CLOSE, PRINTF, SCANF, MALLOC, FREE, MEMSET, MEMCMP, MEMCPY, SBRK, BRK, EXIT
 };
 
-// types
-enum { CHAR, INT, PTR };
+// types (base types in the order of their keywords; LONG and DOUBLE are the wide types)
+enum { CHAR, INT, LONG, DOUBLE, PTR, PTR2 = PTR + PTR };
 
 // identifier offsets (since we can't create an ident struct)
 enum { Tk, Hash, Name, Len, Class, Type, Val, HClass, HType, HVal, IdSz };
 
-enum { SymSz = 1024*IdSz, PoolSz = 256*1024, CodeSz = PoolSz, DataSz = PoolSz, StackSz = PoolSz, AstSz = PoolSz, SrcSz = PoolSz };
+enum { SymSz = 1024*IdSz, PoolSz = 256*1024, CodeSz = PoolSz, DataSz = PoolSz, StackSz = PoolSz, AstSz = PoolSz, SrcSz = PoolSz, BoxSz = 16*PoolSz };
+
+// preprocessor: at most IncD nested includes and macro expansions
+enum { IncD = 64 };
+
+// heap: chunks of HeapSz bytes, blocks up to MinSz << (Classes - 1) bytes are recycled in size classes
+enum { HeapSz = PoolSz, MinSz = 8, Classes = 13 };
+
+// profiler: sample every ProfN cycles, ProfB hash buckets of sampled stacks, at most ProfD frames per stack
+enum { ProfN = 1024, ProfB = 1024, ProfD = 256 };
 
 void next() {
-  char *pp;
+  char *pp, *t;
+  double dv, ds;
+  int i, k, g, *q;
 
-  while ((tk = *p)) {
+  while ((tk = *p) || inp > inb) {
     tp = p++;
-    if (tk == '\n') {
+    if (!tk) { // end of header or macro: the macro expands again
+      if ((q = (int *)*--inp)) q[Class] = Def;
+      fn = (char *)*--inp; line = *--inp; lp = (char *)*--inp; p = (char *)*--inp;
+    }
+    else if (tk == '\n') {
       if (src) {
         printf("%d: %.*s", line, p - lp, lp);
         while (le < e) {
@@ -64,9 +96,85 @@ void next() {
         }
       }
       lp = p; ++line;
+      if (pre == 's' || pre == 'e') { // skip lines up to the matching #endif (or #else)
+        i = 0;
+        while (*p && pre) {
+          while (*p == ' ' || *p == '\t') ++p;
+          if (*p == '#') {
+            ++p; while (*p == ' ' || *p == '\t') ++p;
+            pp = p; while (*p >= 'a' && *p <= 'z') ++p;
+            if (*pp == 'i' && pp[1] == 'f') ++i;
+            else if (p - pp == 5 && !memcmp(pp, "endif", 5)) { if (!i--) pre = 0; }
+            else if (p - pp == 4 && !memcmp(pp, "else", 4) && !i && pre == 's') pre = 0;
+            else if (p - pp == 4 && !memcmp(pp, "elif", 4) && !i) { printf("%s:%d: #elif not supported\n", fn, line); exit(-1); }
+          }
+          while (*p != 0 && *p != '\n') ++p;
+          if (*p) { lp = ++p; ++line; }
+        }
+      }
     }
-    else if (tk == '#') {
-      while (*p != 0 && *p != '\n') ++p;
+    else if (tk == '#') { // #include "file", #define NAME text, #if constant, #ifdef, #ifndef, #else and #endif; other lines are ignored
+      while (*p == ' ' || *p == '\t') ++p;
+      pp = p; while (*p >= 'a' && *p <= 'z') ++p;
+      i = p - pp;
+      while (*p == ' ' || *p == '\t') ++p;
+      if (i == 6 && !memcmp(pp, "define", 6)) pre = 'd';
+      else if (i == 5 && !memcmp(pp, "ifdef", 5)) pre = 'i';
+      else if (i == 6 && !memcmp(pp, "ifndef", 6)) pre = 'n';
+      else if (i == 4 && !memcmp(pp, "else", 4)) { pre = 'e'; while (*p != 0 && *p != '\n') ++p; }
+      else if (i == 2 && !memcmp(pp, "if", 2)) { // #if with an integer constant only
+        if (*p < '0' || *p > '9') { printf("%s:%d: #if supports only integer constants\n", fn, line); exit(-1); }
+        while (*p == '0') ++p;
+        pre = (*p >= '1' && *p <= '9') ? 0 : 's';
+        while (*p != 0 && *p != '\n') ++p;
+      }
+      else if (i == 4 && !memcmp(pp, "elif", 4)) { printf("%s:%d: #elif not supported\n", fn, line); exit(-1); }
+      else if (i == 7 && !memcmp(pp, "include", 7) && *p == '"') { // relative to the including file; a guarded header is read and lexed only once
+        t = pp = fn; while (*pp) { if (*pp++ == '/') t = pp; }
+        k = t - fn;
+        pp = ++p; while (*p != 0 && *p != '"' && *p != '\n') ++p;
+        i = k + (p - pp);
+        if (!(t = malloc(i + 1))) { printf("%s:%d: FATAL: could not malloc(%d) include path\n", fn, line, i + 1); exit(-1); }
+        memcpy(t, fn, k); memcpy(t + k, pp, p - pp); t[i] = 0;
+        while (*p != 0 && *p != '\n') ++p;
+        q = inc; while (q && (q[2] != i || memcmp((char *)q[1], t, i))) q = (int *)*q;
+        if (q && q[3] && q[3] != -1 && ((int *)q[3])[Class] == Def) free(t); // guard defined: the whole header would be skipped
+        else {
+          if (!(pp = malloc(SrcSz))) { printf("%s:%d: FATAL: could not malloc(%d) include area\n", fn, line, SrcSz); exit(-1); }
+          if (q) { free(t); t = (char *)q[1]; }
+          else {
+            if (!(q = malloc(4 * sizeof(int)))) { printf("%s:%d: FATAL: could not malloc(%d) include list\n", fn, line, 4 * sizeof(int)); exit(-1); }
+            q[0] = (int)inc; q[1] = (int)t; q[2] = i; q[3] = 0; inc = q;
+          }
+          if ((k = open(t, 0)) < 0) { printf("%s:%d: FATAL: could not open(%s)\n", fn, line, t); exit(-1); }
+          if ((i = read(k, pp, SrcSz-1)) < 0) { printf("%s:%d: FATAL: read(%s) returned %d\n", fn, line, t, i); exit(-1); }
+          close(k);
+          pp[i] = 0;
+          if (q == inc && !q[3]) { // guarded: first directive #ifndef, its #endif last, only comments outside
+            t = pp; k = g = 0;
+            while (*t && g >= 0) {
+              while (*t == ' ' || *t == '\t' || *t == '\r') ++t;
+              if (*t == '#') {
+                ++t; while (*t == ' ' || *t == '\t') ++t;
+                if (!g) g = memcmp(t, "ifndef", 6) ? -1 : 1;
+                else if (g == 2) g = -1;
+                else if (*t == 'i' && t[1] == 'f') ++k;
+                else if (!memcmp(t, "endif", 5)) { if (!k--) g = 2; }
+                else if (!memcmp(t, "el", 2) && !k) g = -1;
+              }
+              else if (*t && *t != '\n' && *t != '/' && *t != '*' && g != 1) g = -1;
+              while (*t && *t != '\n') ++t;
+              if (*t) ++t;
+            }
+            if (g == 2) q[3] = -1; // the guard identifier is recorded at the #ifndef
+            t = (char *)q[1];
+          }
+          if (inp >= inb + 5 * IncD) { printf("%s:%d: FATAL: include nesting too deep\n", fn, line); exit(-1); }
+          *inp++ = (int)p; *inp++ = (int)lp; *inp++ = line; *inp++ = (int)fn; *inp++ = 0;
+          fn = t; lp = p = pp; line = 1;
+        }
+      }
+      else while (*p != 0 && *p != '\n') ++p; // #endif and other directives
     }
     else if ((tk >= 'a' && tk <= 'z') || (tk >= 'A' && tk <= 'Z') || tk == '_') {
       pp = p - 1;
@@ -74,15 +182,35 @@ void next() {
         tk = tk * 147 + *p++;
       tk = (tk << 6) + (p - pp);
       id = sym;
-      while (id[Tk]) {
-        if (tk == id[Hash] && !memcmp((char *)id[Name], pp, p - pp)) { tk = id[Tk]; return; }
+      while (id[Tk] && (tk != id[Hash] || memcmp((char *)id[Name], pp, p - pp))) {
         id = id + IdSz; if (id >= sym + SymSz) { printf("%s:%d:%d: FATAL: symbol table overflow!\n", fn, line, tp - lp + 1); exit(-1); }
       }
-      id[Hash] = tk;
-      id[Name] = (int)pp;
-      id[Len]  = p - pp;
-      tk = id[Tk] = Id;
-      return;
+      if (!id[Tk]) {
+        id[Hash] = tk;
+        id[Name] = (int)pp;
+        id[Len]  = p - pp;
+        id[Tk] = Id;
+      }
+      if (pre == 'd') { // #define: the rest of the line is the replacement text
+        while (*p == ' ' || *p == '\t') ++p;
+        pp = p; while (*p != 0 && *p != '\n') ++p;
+        if (!(t = malloc(p - pp + 1))) { printf("%s:%d: FATAL: could not malloc(%d) macro\n", fn, line, p - pp + 1); exit(-1); }
+        memcpy(t, pp, p - pp); t[p - pp] = 0;
+        id[Class] = Def; id[Val] = (int)t;
+        pre = 0;
+      }
+      else if (pre) { // #ifdef, #ifndef: skip the group if the condition does not hold
+        if (pre == 'n' && inc && inc[3] == -1 && fn == (char *)inc[1]) inc[3] = (int)id; // include guard of the header just read
+        pre = ((id[Class] == Def) == (pre == 'i')) ? 0 : 's';
+        while (*p != 0 && *p != '\n') ++p;
+      }
+      else if (id[Class] == Def) { // expand macro
+        if (inp >= inb + 5 * IncD) { printf("%s:%d: FATAL: macro nesting too deep\n", fn, line); exit(-1); }
+        *inp++ = (int)p; *inp++ = (int)lp; *inp++ = line; *inp++ = (int)fn; *inp++ = (int)id;
+        id[Class] = 0; // not expanded within its own replacement text
+        p = (char *)id[Val];
+      }
+      else { tk = id[Tk]; return; }
     }
     else if (tk >= '0' && tk <= '9') {
       if ((ival = tk - '0')) { while (*p >= '0' && *p <= '9') ival = ival * 10 + *p++ - '0'; }
@@ -92,6 +220,21 @@ void next() {
       }
       else { while (*p >= '0' && *p <= '7') ival = ival * 8 + *p++ - '0'; }
       tk = Num;
+      if (*p == '.' || *p == 'e' || *p == 'E') { // double literal: rescan decimal digits, store value in data
+        pp = tp; dv = 0;
+        while (*pp >= '0' && *pp <= '9') dv = dv * 10 + (*pp++ - '0');
+        if (*pp == '.') { ++pp; ds = 1; while (*pp >= '0' && *pp <= '9') { dv = dv * 10 + (*pp++ - '0'); ds = ds * 10; } dv = dv / ds; }
+        if (*pp == 'e' || *pp == 'E') {
+          ival = 0; tk = *++pp;
+          if (tk == '+' || tk == '-') ++pp;
+          while (*pp >= '0' && *pp <= '9') ival = ival * 10 + *pp++ - '0';
+          while (ival--) { if (tk == '-') dv = dv / 10; else dv = dv * 10; }
+        }
+        p = pp;
+        d = (char *)(((int)d + sizeof(int) - 1) & -sizeof(int));
+        *(double *)d = dv; ival = (int)d; d = d + sizeof(double);
+        tk = Dbl;
+      }
       return;
     }
     else if (tk == '/') {
@@ -140,13 +283,16 @@ int match(int _tk) {
 }
 
 void expr(int lev) {
-  int *_id, i, _ty, *_n, *pp;
+  int *_id, i, _ty, *_n, *pp, sz, t;
 
   if (!tk) { printf("%s:%d:%d: unexpected eof in expression\n", fn, line, tp - lp + 1); exit(-1); }
   else if (tk == Num) {
     *--n = ival; *--n = Num; next();
     ty = INT;
   }
+  else if (tk == Dbl) {
+    *--n = ival; *--n = Num; *--n = ty = DOUBLE; *--n = Load; next();
+  }
   else if (tk == '"') {
     *--n = ival; *--n = Num; next();
     while (match('"')) ;
@@ -154,12 +300,11 @@ void expr(int lev) {
   }
   else if (match(Sizeof)) {
     if (!match('(')) { printf("%s:%d:%d: '(' expected in sizeof\n", fn, line, tp - lp + 1); exit(-1); }
-    if (match(Int)) ty = INT;
-    else if (match(Char)) { ty = CHAR; }
+    if (tk >= Char && tk <= Double) { ty = tk - Char; next(); if (ty == LONG) match(Long); }
     else { printf("%s:%d:%d: type expected in sizeof\n", fn, line, tp - lp + 1); exit(-1); }
     while (match(Mul)) ty = ty + PTR;
     if (!match(')')) { printf("%s:%d:%d: ')' expected in sizeof\n", fn, line, tp - lp + 1); exit(-1); }
-    *--n = (ty == CHAR) ? sizeof(char) : sizeof(int); *--n = Num;
+    *--n = (ty >= PTR) ? sizeof(int) : tsize[ty]; *--n = Num;
     ty = INT;
   }
   else if (tk == Id) {
@@ -168,7 +313,7 @@ void expr(int lev) {
       if (_id[Class] != Sys && _id[Class] != Fun) { printf("%s:%d:%d: bad function call\n", fn, line, tp - lp + 1); exit(-1); }
       i = 0; pp = 0;
       while (!match(')')) {
-        expr(Assign); *--n = (int)pp; pp = n; ++i;
+        expr(Assign); *--n = ty; *--n = (int)pp; pp = n; i = i + ((ty > INT && ty < PTR) ? ws : 1);
         if (!match(',') && tk != ')') { printf("%s:%d:%d: ',' or ')' expected in function call\n", fn, line, tp - lp + 1); exit(-1); }
       }
       *--n = i; *--n = _id[Val]; *--n = (int)pp; *--n = _id[Class];
@@ -186,11 +331,12 @@ void expr(int lev) {
     }
   }
   else if (match('(')) {
-    if (tk == Int || tk == Char) {
-      _ty = (tk == Int) ? INT : CHAR; next();
+    if (tk >= Char && tk <= Double) {
+      _ty = tk - Char; next(); if (_ty == LONG) match(Long);
       while (match(Mul)) _ty = _ty + PTR;
       if (!match(')')) { printf("%s:%d:%d: bad cast\n", fn, line, tp - lp + 1); exit(-1); }
       expr(Inc);
+      if (_ty != ty && ((_ty > INT && _ty < PTR) || (ty > INT && ty < PTR))) { *--n = ty; *--n = _ty; *--n = Cast; }
       ty = _ty;
     }
     else {
@@ -200,7 +346,7 @@ void expr(int lev) {
   }
   else if (match(Mul)) {
     expr(Inc);
-    if (ty > INT) ty = ty - PTR;
+    if (ty >= PTR) ty = ty - PTR;
     else { printf("%s:%d:%d: bad dereference\n", fn, line, tp - lp + 1); exit(-1); }
     *--n = ty; *--n = Load;
   }
@@ -213,19 +359,20 @@ void expr(int lev) {
   else if (match('!')) {
     expr(Inc);
     if (*n == Num) n[1] = !n[1];
-    else { *--n = 0; *--n = Num; --n; *n = (int)(n+3); *--n = Eq; }
+    else { *--n = 0; *--n = Num; --n; *n = (int)(n+3); *--n = Eq; if (ty > INT && ty < PTR) { *--n = INT; *--n = ty; *--n = ty; *--n = Wide; } }
     ty = INT;
   }
   else if (match('~')) {
     expr(Inc);
-    if (*n == Num) n[1] = ~n[1]; else { *--n = -1; *--n = Num; --n; *n = (int)(n+3); *--n = Xor; }
-    ty = INT;
+    if (ty == DOUBLE) { printf("%s:%d:%d: bad double operation\n", fn, line, tp - lp + 1); exit(-1); }
+    if (*n == Num) n[1] = ~n[1]; else { *--n = -1; *--n = Num; --n; *n = (int)(n+3); *--n = Xor; if (ty == LONG) { *--n = INT; *--n = ty; *--n = ty; *--n = Wide; } }
+    if (ty != LONG) ty = INT;
   }
-  else if (match(Add)) { expr(Inc); ty = INT; }
+  else if (match(Add)) { expr(Inc); if (ty < LONG || ty >= PTR) ty = INT; }
   else if (match(Sub)) {
     expr(Inc);
-    if (*n == Num) n[1] = -n[1]; else { *--n = -1; *--n = Num; --n; *n = (int)(n+3); *--n = Mul; }
-    ty = INT;
+    if (*n == Num) n[1] = -n[1]; else { *--n = -1; *--n = Num; --n; *n = (int)(n+3); *--n = Mul; if (ty > INT && ty < PTR) { *--n = INT; *--n = ty; *--n = ty; *--n = Wide; } }
+    if (ty < LONG || ty >= PTR) ty = INT;
   }
   else if (tk == Inc || tk == Dec) {
     i = tk; next();
@@ -240,67 +387,98 @@ void expr(int lev) {
     if (match(Assign)) {
       if (*n != Load) { printf("%s:%d:%d: bad lvalue in assignment\n", fn, line, tp - lp + 1); exit(-1); }
       expr(Assign);
+      if (_ty != ty && ((_ty > INT && _ty < PTR) || (ty > INT && ty < PTR))) { *--n = ty; *--n = _ty; *--n = Cast; }
       *--n = (int)(_n+2); *--n = ty = _ty; *--n = Assign;
     }
     else if (match(Cond)) {
+      if (ty > INT && ty < PTR) { *--n = 0; *--n = Num; --n; *n = (int)(n+3); *--n = Ne; *--n = INT; *--n = ty; *--n = ty; *--n = Wide; _n = n; }
       expr(Assign);
       if (!match(':')) { printf("%s:%d:%d: conditional missing colon\n", fn, line, tp - lp + 1); exit(-1); }
-      pp = n;
+      pp = n; t = ty; i = 0;
       expr(Cond);
-      --n; *n = (int)(n+1); *--n = (int)pp; *--n = (int)_n; *--n = Cond;
-    }
-    else if (match(Lor))  { expr(Land); if (*n==Num && *_n==Num) n[1] = _n[1] || n[1]; else { *--n = (int)_n; *--n = Lor;  } ty = INT; }
-    else if (match(Land)) { expr(Or);   if (*n==Num && *_n==Num) n[1] = _n[1] && n[1]; else { *--n = (int)_n; *--n = Land; } ty = INT; }
-    else if (match(Or))   { expr(Xor);  if (*n==Num && *_n==Num) n[1] = _n[1] |  n[1]; else { *--n = (int)_n; *--n = Or;   } ty = INT; }
-    else if (match(Xor))  { expr(And);  if (*n==Num && *_n==Num) n[1] = _n[1] ^  n[1]; else { *--n = (int)_n; *--n = Xor;  } ty = INT; }
-    else if (match(And))  { expr(Eq);   if (*n==Num && *_n==Num) n[1] = _n[1] &  n[1]; else { *--n = (int)_n; *--n = And;  } ty = INT; }
-    else if (match(Eq))   { expr(Lt);   if (*n==Num && *_n==Num) n[1] = _n[1] == n[1]; else { *--n = (int)_n; *--n = Eq;   } ty = INT; }
-    else if (match(Ne))   { expr(Lt);   if (*n==Num && *_n==Num) n[1] = _n[1] != n[1]; else { *--n = (int)_n; *--n = Ne;   } ty = INT; }
-    else if (match(Lt))   { expr(Shl);  if (*n==Num && *_n==Num) n[1] = _n[1] <  n[1]; else { *--n = (int)_n; *--n = Lt;   } ty = INT; }
-    else if (match(Gt))   { expr(Shl);  if (*n==Num && *_n==Num) n[1] = _n[1] >  n[1]; else { *--n = (int)_n; *--n = Gt;   } ty = INT; }
-    else if (match(Le))   { expr(Shl);  if (*n==Num && *_n==Num) n[1] = _n[1] <= n[1]; else { *--n = (int)_n; *--n = Le;   } ty = INT; }
-    else if (match(Ge))   { expr(Shl);  if (*n==Num && *_n==Num) n[1] = _n[1] >= n[1]; else { *--n = (int)_n; *--n = Ge;   } ty = INT; }
-    else if (match(Shl))  { expr(Add);  if (*n==Num && *_n==Num) n[1] = _n[1] << n[1]; else { *--n = (int)_n; *--n = Shl;  } ty = INT; }
-    else if (match(Shr))  { expr(Add);  if (*n==Num && *_n==Num) n[1] = _n[1] >> n[1]; else { *--n = (int)_n; *--n = Shr;  } ty = INT; }
-    else if (match(Add)) {
-      expr(Mul);
-      if (ty >= PTR) { printf("%s:%d:%d: bad pointer addition\n", fn, line, tp - lp + 1); exit(-1); }
-      if (_ty > PTR) {
-        if (*n == Num) n[1] = n[1] * sizeof(int); // lhs > PTR && rhs == Num
-        else { *--n = sizeof(int); *--n = Num; --n; *n = (int)(n+3); *--n = Mul; } // lhs > PTR && rhs != Num
+      if (t != ty && ((t > INT && t < PTR) || (ty > INT && ty < PTR))) { // mixed width branches: convert both to the wider type
+        if (t >= PTR || ty >= PTR) { printf("%s:%d:%d: bad conditional types\n", fn, line, tp - lp + 1); exit(-1); }
+        _ty = (t == DOUBLE || ty == DOUBLE) ? DOUBLE : LONG;
+        if (ty != _ty) { *--n = ty; *--n = _ty; *--n = Cast; }
+        if (t != _ty) i = (_ty == LONG) ? ITL : (t == LONG) ? LTF : ITF;
+        ty = _ty;
       }
-      if (*n == Num && *_n == Num) { n[1] = _n[1] + n[1]; ty = _ty; }
-      else { *--n = (int)_n; *--n = Add; ty = (_ty == ty) ? INT : _ty; }
+      *--n = i; --n; *n = (int)(n+2); *--n = (int)pp; *--n = (int)_n; *--n = Cond;
     }
-    else if (match(Sub)) {
-      expr(Mul);
-      if (_ty < PTR && ty >= PTR) { printf("%s:%d:%d: bad pointer subtraction\n", fn, line, tp - lp + 1); exit(-1); }
-      if (_ty >= PTR && ty >= PTR && _ty != ty) { printf("%s:%d:%d: bad pointer types in subtraction\n", fn, line, tp - lp + 1); exit(-1); }
-      if (_ty > PTR) {
-        if (*n == Num) n[1] = n[1] * sizeof(int);
-        else if (_ty != ty) { *--n = sizeof(int); *--n = Num; --n; *n = (int)(n+3); *--n = Mul; }
+    else if (tk == Lor || tk == Land) {
+      i = tk; next();
+      if (ty > INT && ty < PTR) { *--n = 0; *--n = Num; --n; *n = (int)(n+3); *--n = Ne; *--n = INT; *--n = ty; *--n = ty; *--n = Wide; _n = n; }
+      expr((i == Lor) ? Land : Or);
+      if (ty > INT && ty < PTR) { *--n = 0; *--n = Num; --n; *n = (int)(n+3); *--n = Ne; *--n = INT; *--n = ty; *--n = ty; *--n = Wide; }
+      if (i == Lor) { if (*n==Num && *_n==Num) n[1] = _n[1] || n[1]; else { *--n = (int)_n; *--n = Lor;  } }
+      else          { if (*n==Num && *_n==Num) n[1] = _n[1] && n[1]; else { *--n = (int)_n; *--n = Land; } }
+      ty = INT;
+    }
+    else if (tk >= Or && tk <= Mod) { // right operand binds one precedence level tighter
+      i = tk; next();
+      expr((i < Eq) ? i + 1 : (i < Lt) ? Lt : (i < Shl) ? Shl : (i < Add) ? Add : (i < Mul) ? Mul : Inc);
+      if ((_ty > INT && _ty < PTR) || (ty > INT && ty < PTR)) { // long long or double operands
+        if (_ty >= PTR || ty >= PTR) { printf("%s:%d:%d: bad pointer arithmetic\n", fn, line, tp - lp + 1); exit(-1); }
+        t = (_ty == DOUBLE || ty == DOUBLE) ? DOUBLE : LONG;
+        if (t == DOUBLE && (i < Eq || i == Shl || i == Shr || i == Mod)) { printf("%s:%d:%d: bad double operation\n", fn, line, tp - lp + 1); exit(-1); }
+        *--n = (int)_n; *--n = i; *--n = ty; *--n = _ty; *--n = t; *--n = Wide;
+        ty = (i >= Eq && i <= Ge) ? INT : t;
       }
-      if (*n == Num && *_n == Num) { n[1] = _n[1] - n[1]; ty = _ty; }
-      else {
-        *--n = (int)_n; *--n = Sub;
-        if (_ty > PTR && ty > PTR) { *--n = sizeof(int); *--n = Num; --n; *n = (int)(n+3); *--n = Div; }
-        ty = (_ty == ty) ? INT : _ty;
+      else if (i == Or)  { if (*n==Num && *_n==Num) n[1] = _n[1] |  n[1]; else { *--n = (int)_n; *--n = Or;   } ty = INT; }
+      else if (i == Xor) { if (*n==Num && *_n==Num) n[1] = _n[1] ^  n[1]; else { *--n = (int)_n; *--n = Xor;  } ty = INT; }
+      else if (i == And) { if (*n==Num && *_n==Num) n[1] = _n[1] &  n[1]; else { *--n = (int)_n; *--n = And;  } ty = INT; }
+      else if (i == Eq)  { if (*n==Num && *_n==Num) n[1] = _n[1] == n[1]; else { *--n = (int)_n; *--n = Eq;   } ty = INT; }
+      else if (i == Ne)  { if (*n==Num && *_n==Num) n[1] = _n[1] != n[1]; else { *--n = (int)_n; *--n = Ne;   } ty = INT; }
+      else if (i == Lt)  { if (*n==Num && *_n==Num) n[1] = _n[1] <  n[1]; else { *--n = (int)_n; *--n = Lt;   } ty = INT; }
+      else if (i == Gt)  { if (*n==Num && *_n==Num) n[1] = _n[1] >  n[1]; else { *--n = (int)_n; *--n = Gt;   } ty = INT; }
+      else if (i == Le)  { if (*n==Num && *_n==Num) n[1] = _n[1] <= n[1]; else { *--n = (int)_n; *--n = Le;   } ty = INT; }
+      else if (i == Ge)  { if (*n==Num && *_n==Num) n[1] = _n[1] >= n[1]; else { *--n = (int)_n; *--n = Ge;   } ty = INT; }
+      else if (i == Shl) { if (*n==Num && *_n==Num) n[1] = _n[1] << n[1]; else { *--n = (int)_n; *--n = Shl;  } ty = INT; }
+      else if (i == Shr) { if (*n==Num && *_n==Num) n[1] = _n[1] >> n[1]; else { *--n = (int)_n; *--n = Shr;  } ty = INT; }
+      else if (i == Add) {
+        if (ty >= PTR) { printf("%s:%d:%d: bad pointer addition\n", fn, line, tp - lp + 1); exit(-1); }
+        if (_ty > PTR) {
+          sz = (_ty >= PTR2) ? sizeof(int) : tsize[_ty - PTR];
+          if (*n == Num) n[1] = n[1] * sz; // lhs > PTR && rhs == Num
+          else { *--n = sz; *--n = Num; --n; *n = (int)(n+3); *--n = Mul; } // lhs > PTR && rhs != Num
+        }
+        if (*n == Num && *_n == Num) { n[1] = _n[1] + n[1]; ty = _ty; }
+        else { *--n = (int)_n; *--n = Add; ty = (_ty == ty) ? INT : _ty; }
       }
+      else if (i == Sub) {
+        if (_ty < PTR && ty >= PTR) { printf("%s:%d:%d: bad pointer subtraction\n", fn, line, tp - lp + 1); exit(-1); }
+        if (_ty >= PTR && ty >= PTR && _ty != ty) { printf("%s:%d:%d: bad pointer types in subtraction\n", fn, line, tp - lp + 1); exit(-1); }
+        if (_ty > PTR) {
+          sz = (_ty >= PTR2) ? sizeof(int) : tsize[_ty - PTR];
+          if (*n == Num) n[1] = n[1] * sz;
+          else if (_ty != ty) { *--n = sz; *--n = Num; --n; *n = (int)(n+3); *--n = Mul; }
+        }
+        if (*n == Num && *_n == Num) { n[1] = _n[1] - n[1]; ty = _ty; }
+        else {
+          *--n = (int)_n; *--n = Sub;
+          if (_ty > PTR && ty > PTR) { *--n = sz; *--n = Num; --n; *n = (int)(n+3); *--n = Div; }
+          ty = (_ty == ty) ? INT : _ty;
+        }
+      }
+      else if (i == Mul) { if (*n==Num && *_n==Num) n[1] = _n[1] * n[1]; else { *--n = (int)_n; *--n = Mul; } ty = INT; }
+      else if (i == Div) { if (*n==Num && *_n==Num) n[1] = _n[1] / n[1]; else { *--n = (int)_n; *--n = Div; } ty = INT; }
+      else               { if (*n==Num && *_n==Num) n[1] = _n[1] % n[1]; else { *--n = (int)_n; *--n = Mod; } ty = INT; }
     }
-    else if (match(Mul)) { expr(Inc); if (*n==Num && *_n==Num) n[1] = _n[1] * n[1]; else { *--n = (int)_n; *--n = Mul; } ty = INT; }
-    else if (match(Div)) { expr(Inc); if (*n==Num && *_n==Num) n[1] = _n[1] / n[1]; else { *--n = (int)_n; *--n = Div; } ty = INT; }
-    else if (match(Mod)) { expr(Inc); if (*n==Num && *_n==Num) n[1] = _n[1] % n[1]; else { *--n = (int)_n; *--n = Mod; } ty = INT; }
     else if (tk == Inc || tk == Dec) {
       if (*n == Load) *n = tk;
       else { printf("%s:%d:%d: bad lvalue in post-increment\n", fn, line, tp - lp + 1); exit(-1); }
-      *--n = (ty > PTR) ? sizeof(int) : sizeof(char); *--n = Num;
+      *--n = (ty >= PTR2) ? sizeof(int) : (ty > PTR) ? tsize[ty - PTR] : sizeof(char); *--n = Num;
       *--n = (int)_n; *--n = (tk == Inc) ? Sub : Add; next();
+      if (ty > INT && ty < PTR) { *--n = INT; *--n = ty; *--n = ty; *--n = Wide; }
     }
     else if (match(Bracket)) {
       if (_ty < PTR) { printf("%s:%d:%d: pointer type expected\n", fn, line, tp - lp + 1); exit(-1); }
       expr(Assign);
       if (!match(']')) { printf("%s:%d:%d: ']' expected\n", fn, line, tp - lp + 1); exit(-1); }
-      if (_ty > PTR) { if (*n == Num) n[1] = n[1] * sizeof(int); else { *--n = sizeof(int); *--n = Num; --n; *n = (int)(n+3); *--n = Mul; } }
+      if (_ty > PTR) {
+        sz = (_ty >= PTR2) ? sizeof(int) : tsize[_ty - PTR];
+        if (*n == Num) n[1] = n[1] * sz; else { *--n = sz; *--n = Num; --n; *n = (int)(n+3); *--n = Mul; }
+      }
       if (*n == Num && *_n == Num) n[1] = _n[1] + n[1]; else { *--n = (int)_n; *--n = Add; }
       *--n = ty = _ty - PTR; *--n = Load;
     }
@@ -313,21 +491,30 @@ void stmt() {
 
   if (match(If)) {
     if (!match('(')) { printf("%s:%d:%d: '(' expected in if\n", fn, line, tp - lp + 1); exit(-1); }
-    expr(Assign); n1 = n;
+    expr(Assign);
+    if (ty > INT && ty < PTR) { *--n = 0; *--n = Num; --n; *n = (int)(n+3); *--n = Ne; *--n = INT; *--n = ty; *--n = ty; *--n = Wide; }
+    n1 = n;
     if (!match(')')) { printf("%s:%d:%d: ')' expected in if\n", fn, line, tp - lp + 1); exit(-1); }
     stmt(); n2 = n;
     if (match(Else)) { stmt(); n3 = n; } else n3 = 0;
-    *--n = (int)n3; *--n = (int)n2; *--n = (int)n1; *--n = Cond;
+    *--n = 0; *--n = (int)n3; *--n = (int)n2; *--n = (int)n1; *--n = Cond;
   }
   else if (match(While)) {
     if (!match('(')) { printf("%s:%d:%d: '(' expected in while\n", fn, line, tp - lp + 1); exit(-1); }
-    expr(Assign); n1 = n;
+    expr(Assign);
+    if (ty > INT && ty < PTR) { *--n = 0; *--n = Num; --n; *n = (int)(n+3); *--n = Ne; *--n = INT; *--n = ty; *--n = ty; *--n = Wide; }
+    n1 = n;
     if (!match(')')) { printf("%s:%d:%d: ')' expected in while\n", fn, line, tp - lp + 1); exit(-1); }
     stmt();
     *--n = (int)n1; *--n = While;
   }
   else if (match(Return)) {
-    if (tk != ';') { expr(Assign); n1 = n; } else n1 = 0;
+    if (tk != ';') {
+      expr(Assign);
+      if (fty != ty && ((fty > INT && fty < PTR) || (ty > INT && ty < PTR))) { *--n = ty; *--n = fty; *--n = Cast; }
+      n1 = n;
+    }
+    else n1 = 0;
     if (!match(';')) { printf("%s:%d:%d: ';' expected in return\n", fn, line, tp - lp + 1); exit(-1); }
     *--n = (int)n1; *--n = Return;
   }
@@ -352,19 +539,41 @@ void gen(int *n) { // hide global n
   i = *n;
   if (i == Num) { *++e = IMM; *++e = n[1]; }
   else if (i == Local) { *++e = LEA; *++e = n[1]; }
-  else if (i == Load) { gen(n+2); *++e = (n[1] == CHAR) ? LC : LI; }
-  else if (i == Assign) { gen((int *)n[2]); *++e = PUSH; gen(n+3); *++e = (n[1] == CHAR) ? SC : SI; }
+  else if (i == Load) { gen(n+2); *++e = (n[1] == CHAR) ? LC : (n[1] == LONG) ? LDL : (n[1] == DOUBLE) ? LDD : LI; }
+  else if (i == Assign) { gen((int *)n[2]); *++e = PUSH; gen(n+3); *++e = (n[1] == CHAR) ? SC : (n[1] == LONG) ? STL : (n[1] == DOUBLE) ? STD : SI; }
+  else if ((i == Inc || i == Dec) && (n[1] == LONG || n[1] == DOUBLE)) {
+    gen(n+2);
+    *++e = PUSH; *++e = (n[1] == LONG) ? LDL : LDD; *++e = (n[1] == LONG) ? PSHL : PSHD;
+    *++e = IMM; *++e = 1; *++e = (n[1] == LONG) ? ITL : ITF;
+    *++e = (n[1] == LONG) ? ((i == Inc) ? LADD : LSUB) : ((i == Inc) ? FADD : FSUB);
+    *++e = (n[1] == LONG) ? STL : STD;
+  }
   else if (i == Inc || i == Dec) {
     gen(n+2);
     *++e = PUSH; *++e = (n[1] == CHAR) ? LC : LI; *++e = PUSH;
-    *++e = IMM; *++e = (n[1] > PTR) ? sizeof(int) : sizeof(char);
+    *++e = IMM; *++e = (n[1] >= PTR2) ? sizeof(int) : (n[1] > PTR) ? tsize[n[1] - PTR] : sizeof(char);
     *++e = (i == Inc) ? ADD : SUB;
     *++e = (n[1] == CHAR) ? SC : SI;
   }  
-  else if (i == Cond) {
+  else if (i == Cast) {
+    gen(n+3);
+    if (n[1] == LONG) *++e = (n[2] == DOUBLE) ? FTL : ITL;
+    else if (n[1] == DOUBLE) *++e = (n[2] == LONG) ? LTF : ITF;
+    else *++e = (n[2] == LONG) ? LTI : FTI;
+  }
+  else if (i == Wide) { // n[1]: operation type, n[2]/n[3]: lhs/rhs type, n[4]: operator
+    gen((int *)n[5]);
+    if (n[2] != n[1]) *++e = (n[1] == LONG) ? ((n[2] == DOUBLE) ? FTL : ITL) : ((n[2] == LONG) ? LTF : ITF);
+    *++e = (n[1] == LONG) ? PSHL : PSHD;
+    gen(n+6);
+    if (n[3] != n[1]) *++e = (n[1] == LONG) ? ((n[3] == DOUBLE) ? FTL : ITL) : ((n[3] == LONG) ? LTF : ITF);
+    *++e = (n[1] == LONG) ? LOR + n[4] - Or : (n[4] <= Ge) ? FEQ + n[4] - Eq : FADD + n[4] - Add;
+  }
+  else if (i == Cond) { // n[4]: conversion of the true branch to the result type, if any
     gen((int *)n[1]);
     *++e = BZ; pp = ++e;
     gen((int *)n[2]);
+    if (n[4]) *++e = n[4];
     if (n[3]) { *pp = (int)(e + 3); *++e = JMP; pp = ++e; gen((int *)n[3]); }
     *pp = (int)(e + 1);
   }
@@ -388,7 +597,7 @@ void gen(int *n) { // hide global n
   else if (i == Mod)  { gen((int *)n[1]); *++e = PUSH; gen(n+2); *++e = MOD; }
   else if (i == Sys || i == Fun) {
     pp = (int *)n[1];
-    while (pp) { gen(pp+1); *++e = PUSH; pp = (int *)*pp; }
+    while (pp) { gen(pp+2); *++e = (pp[1] == LONG) ? PSHL : (pp[1] == DOUBLE) ? PSHD : PUSH; pp = (int *)*pp; }
     if (i == Fun) { *++e = JSR; } *++e = n[2];
     if (n[3]) { *++e = ADJ; *++e = n[3]; }
   }
@@ -409,6 +618,7 @@ void parse() {
   int fd, *top, bt, i, *_id, *_n;
 
   if (!(lp = p = src = malloc(SrcSz))) { printf("FATAL: could not malloc(%d) source area\n", SrcSz); exit(-1); }
+  if (!(inp = inb = malloc(5 * IncD * sizeof(int)))) { printf("FATAL: could not malloc(%d) input stack\n", 5 * IncD * sizeof(int)); exit(-1); }
 
   if ((fd = open(fn, 0)) < 0) { printf("FATAL: could not open(%s)\n", fn); exit(-1); }
   if ((i = read(fd, p, SrcSz-1)) <= 0) { printf("FATAL: read() returned %d\n", i); exit(-1); }
@@ -421,7 +631,7 @@ void parse() {
   line = 1; next();
   while (tk) {
     bt = INT; // basetype
-    if (match(Char)) bt = CHAR;
+    if (tk >= Char && tk <= Double) { bt = tk - Char; next(); if (bt == LONG) match(Long); }
     else if (match(Enum)) {
       if (!match('{')) { printf("%s:%d:%d: bad enum definition\n", fn, line, tp - lp + 1); exit(-1); }
       i = 0;
@@ -439,7 +649,7 @@ void parse() {
         if (!match(',') && tk != '}') { printf("%s:%d:%d: ',' or '}' expected in enum declaration\n", fn, line, tp - lp + 1); exit(-1); }
       }
     }
-    else if (!match(Int)) { printf("%s:%d:%d: type expected\n", fn, line, tp - lp + 1); exit(-1); }
+    else { printf("%s:%d:%d: type expected\n", fn, line, tp - lp + 1); exit(-1); }
 
     while (!match(';')) {
       ty = bt;
@@ -453,26 +663,27 @@ void parse() {
       if (match('(')) { // function
         _id[Class] = Fun;
         _id[Val] = (int)(e + 1);
+        fty = _id[Type];
 
         i = 2;
         while (!match(')')) {
-          if (match(Int)) ty = INT;
-          else if (match(Char)) ty = CHAR;
+          if (tk >= Char && tk <= Double) { ty = tk - Char; next(); if (ty == LONG) match(Long); }
           else { printf("%s:%d:%d: parameter type expected\n", fn, line, tp - lp + 1); exit(-1); }
           while (match(Mul))ty = ty + PTR;
           if (tk != Id) { printf("%s:%d:%d: bad parameter declaration\n", fn, line, tp - lp + 1); exit(-1); }
           if (id[Class] == Local) { printf("%s:%d:%d: duplicate parameter definition\n", fn, line, tp - lp + 1); exit(-1); }
           id[HClass] = id[Class]; id[Class] = Local;
           id[HType]  = id[Type];  id[Type]  = ty;
-          id[HVal]   = id[Val];   id[Val]   = i++;
+          id[HVal]   = id[Val];   id[Val]   = i;
+          i = i + ((ty > INT && ty < PTR) ? ws : 1);
           next();
           if (!match(',') && tk != ')') { printf("%s:%d:%d: ',' or ')' expected in parameter declaration\n", fn, line, tp - lp + 1); exit(-1); }
         }
 
         if (!match('{')) { printf("%s:%d:%d: bad function definition\n", fn, line, tp - lp + 1); exit(-1); }
         i = 0;
-        while (tk == Int || tk == Char) {
-          bt = (tk == Int) ? INT : CHAR; next();
+        while (tk >= Char && tk <= Double) {
+          bt = tk - Char; next(); if (bt == LONG) match(Long);
           while (!match(';')) {
             ty = bt;
             while (match(Mul)) ty = ty + PTR;
@@ -483,12 +694,12 @@ void parse() {
               n = top;
               expr(Cond);
               if (*n != Num) { printf("%s:%d:%d: bad local array initializer\n", fn, line, tp - lp + 1); exit(-1); }
-              i = i - ((ty == CHAR) ? ((n[1] + sizeof (int) - 1) & -sizeof (int))/sizeof (int) : n[1]);
+              i = i - (n[1] * ((ty >= PTR) ? sizeof (int) : tsize[ty]) + sizeof (int) - 1) / sizeof (int);
               ty = ty + PTR;
               if (dbg) printf("i:%d, ty:#%d\n", i, ty);
               if (!match(']')) { printf("%s:%d:%d: ']' expected in local array declaration\n", fn, line, tp - lp + 1); exit(-1); }
             }
-            else --i;
+            else i = i - ((ty > INT && ty < PTR) ? ws : 1);
             _id[HClass] = _id[Class]; _id[Class] = Local;
             _id[HType]  = _id[Type];  _id[Type]  = ty;
             _id[HVal]   = _id[Val];   _id[Val]   = i;
@@ -519,24 +730,33 @@ void parse() {
           n = top;
           expr(Cond);
           if (*n != Num) { printf("%s:%d:%d: bad global array initializer\n", fn, line, tp - lp + 1); exit(-1); }
-          d = d + ((_id[Type] == CHAR) ? (n[1] + sizeof (int) - 1) & -sizeof (int) : n[1] * sizeof(int));
+          d = d + ((n[1] * ((_id[Type] >= PTR) ? sizeof (int) : tsize[_id[Type]]) + sizeof (int) - 1) & -sizeof (int));
           _id[Type] = _id[Type] + PTR;
           if (dbg) printf("_id[Type]:#%d\n", _id[Type]);
           if (!match(']')) { printf("%s:%d:%d: ']' expected in global array declaration\n", fn, line, tp - lp + 1); exit(-1); }
         }
-        else d = d + sizeof(int);
+        else d = d + ((_id[Type] > INT && _id[Type] < PTR) ? ws : 1) * sizeof(int);
       }
       if (!match(',') && tk != ';') { printf("%s:%d:%d: ',' or ';' expected\n", fn, line, tp - lp + 1); exit(-1); }
     }
   }
 
   free(ast);
-  free(src); lp = p = 0;
+  free(inb);
+  if (!prof) free(src);
+  lp = p = 0;
 }
 
 int run(int argc, char **argv) {
   int *pc, *sp, *bp, a; // vm registers
-  int i, *pp, cycle;
+  long long w;          // wide accumulator
+  double f;             // floating accumulator
+  int amask, abase;     // address mask and base (identity unless sandboxed)
+  int *hc, *fl, *hq;    // heap chunk chain, size class free lists
+  int *fm, *pb, *ps;    // profiler function map, stack buckets, sampled stack
+  char *hp, *he;        // heap bump position and end of current chunk
+  int i, *pp, *q, cycle, sz, hs;
+  char *t, *ic;
 
   if (dbg) printf("DBG: code size:%d data size:%d\n", e - code, d - data);
 
@@ -546,6 +766,35 @@ int run(int argc, char **argv) {
   // call exit if main returns
   *++e = PUSH; pp = e;
   *++e = EXIT;
+  amask = -1; abase = 0;
+  if (sbx) {
+    amask = BoxSz - 1; abase = (int)data;
+    // mark instruction starts; a return must land right behind a JSR
+    if (!(ic = malloc(e - code + 1))) { printf("FATAL: could not malloc(%d) instruction map\n", e - code + 1); exit(-1); }
+    memset(ic, 0, e - code + 1);
+    sp = code + 1; while (sp <= e) { ic[sp - code] = 1; sp = sp + ((*sp <= ADJ) ? 2 : 1); }
+    // copy arguments into the sandbox
+    d = (char *)(((int)d + sizeof(int) - 1) & -sizeof(int));
+    sp = (int *)d; d = d + argc * sizeof(int);
+    i = 0;
+    while (i < argc) { sp[i] = (int)d; t = argv[i++]; while (*t) *d++ = *t++; *d++ = 0; }
+    argv = (char **)sp;
+    d = (char *)(((int)d + sizeof(int) - 1) & -sizeof(int));
+  }
+  if (prof) { // map each instruction to its function
+    if (!(fm = malloc((e - code + 1) * sizeof(int))) || !(pb = malloc(ProfB * sizeof(int))) || !(ps = malloc(ProfD * sizeof(int)))) {
+      printf("FATAL: could not malloc() profiler area\n"); exit(-1);
+    }
+    memset(fm, 0, (e - code + 1) * sizeof(int));
+    memset(pb, 0, ProfB * sizeof(int));
+    id = sym; while (id[Tk]) { if (id[Class] == Fun) fm[(int *)id[Val] - code] = (int)id; id = id + IdSz; }
+    i = 1; while (i <= e - code) { if (!fm[i]) fm[i] = fm[i - 1]; ++i; }
+  }
+  else { free(sym); sym = 0; } // the profiler needs the function names
+  // setup heap
+  if (!(fl = malloc(Classes * sizeof(int)))) { printf("FATAL: could not malloc(%d) free lists\n", Classes * sizeof(int)); exit(-1); }
+  memset(fl, 0, Classes * sizeof(int));
+  hc = 0; hp = he = 0;
   // setup stack
   bp = sp = (int *)((int)stack + StackSz);
   *--sp = (int)argv;
@@ -555,6 +804,22 @@ int run(int argc, char **argv) {
   // run...
   a = cycle = 0;
   while (1) {
+    if (prof && !(cycle & (ProfN - 1)) && pc < pp) { // sample: walk the frame chain leaf first, count the stack in its bucket
+      sz = 0; ps[sz++] = fm[pc - code];
+      if (*pc == ENTER) { hs = *sp; q = bp; } else { hs = bp[1]; q = (int *)*bp; } // ENTER: frame not yet linked
+      while (sz < ProfD && (int *)hs > code && (int *)hs < pp && q >= sp && q < (int *)((int)stack + StackSz) - 1) {
+        ps[sz++] = fm[(int *)hs - code]; hs = q[1]; q = (int *)*q;
+      }
+      hs = sz; i = 0; while (i < sz) hs = hs * 147 + ps[i++];
+      q = pb + (hs & (ProfB - 1));
+      while (*q && (((int *)*q)[2] != sz || memcmp((int *)*q + 3, ps, sz * sizeof(int)))) q = (int *)*q;
+      if (!*q) {
+        if (!(hq = malloc((sz + 3) * sizeof(int)))) { printf("FATAL: could not malloc() profiler stack\n"); exit(-1); }
+        hq[0] = 0; hq[1] = 0; hq[2] = sz; memcpy(hq + 3, ps, sz * sizeof(int));
+        *q = (int)hq;
+      }
+      hq = (int *)*q; hq[1] = hq[1] + 1;
+    }
     i = *pc++; ++cycle;
     if (dbg) {
       printf("%d> %s", cycle,
@@ -568,13 +833,21 @@ int run(int argc, char **argv) {
     else if (i == JSR)   { *--sp = (int)(pc + 1); pc = (int *)*pc; }        // jump to subroutine
     else if (i == BZ)    pc = a ? pc + 1 : (int *)*pc;                      // branch if zero
     else if (i == BNZ)   pc = a ? (int *)*pc : pc + 1;                      // branch if not zero
-    else if (i == ENTER) { *--sp = (int)bp; bp = sp; sp = sp - *pc++; }     // enter subroutine
+    else if (i == ENTER) {                                                  // enter subroutine
+      *--sp = (int)bp; bp = sp; sp = sp - *pc++;
+      if (sp < stack) { printf("stack overflow! cycle = %d\n", cycle); return -1; }
+    }
     else if (i == ADJ)   sp = sp + *pc++;                                   // stack adjust
-    else if (i == LEAVE) { sp = bp; bp = (int *)*sp++; pc = (int *)*sp++; } // leave subroutine
-    else if (i == LI)    a = *(int *)a;                                     // load int
-    else if (i == LC)    a = *(char *)a;                                    // load char
-    else if (i == SI)    *(int *)*sp++ = a;                                 // store int
-    else if (i == SC)    a = *(char *)*sp++ = a;                            // store char
+    else if (i == LEAVE) {                                                  // leave subroutine
+      sp = bp; bp = (int *)*sp++; pc = (int *)*sp++;
+      if (sbx && pc != pp && (pc <= code + 2 || pc > e || !ic[pc - code - 2] || pc[-2] != JSR || bp < sp || bp > stack + StackSz / sizeof(int))) {
+        printf("sandbox violation: bad stack frame! cycle = %d\n", cycle); return -1;
+      }
+    }
+    else if (i == LI)    a = *(int *)((a & amask) | abase);                 // load int
+    else if (i == LC)    a = *(char *)((a & amask) | abase);                // load char
+    else if (i == SI)    *(int *)((*sp++ & amask) | abase) = a;             // store int
+    else if (i == SC)    a = *(char *)((*sp++ & amask) | abase) = a;        // store char
     else if (i == PUSH)  *--sp = a;                                         // push
 
     else if (i == OR)  a = *sp++ |  a;
@@ -594,20 +867,170 @@ int run(int argc, char **argv) {
     else if (i == DIV) a = *sp++ /  a;
     else if (i == MOD) a = *sp++ %  a;
 
-    else if (i == OPEN)   a = open((char *)*sp, sp[1]);
-    else if (i == READ)   a = read(*sp, (char *)sp[1], sp[2]);
-    else if (i == WRITE)  a = write(*sp, (char *)sp[1], sp[2]);
-    else if (i == CLOSE)  a = close(*sp);
-    else if (i == PRINTF) a = printf((char *)*sp, sp[1], sp[2], sp[3], sp[4], sp[5], sp[6], sp[7]);
-    else if (i == SCANF)  a = scanf((char *)*sp, sp[1], sp[2], sp[3], sp[4], sp[5], sp[6], sp[7]);
-    else if (i == MALLOC) a = (int)malloc(*sp);
-    else if (i == FREE)   free((char *)*sp);
-    else if (i == MEMSET) a = (int)memset((char *)*sp, sp[1], sp[2]);
-    else if (i == MEMCMP) a = memcmp((char *)*sp, (char *)sp[1], sp[2]);
-    else if (i == MEMCPY) a = (int)memcpy((char *)*sp, (char *)sp[1], sp[2]);
-    else if (i == SBRK)   { a = (int)d; d = d + *sp; }
-    else if (i == BRK)    d = (char *)*sp;
-    else if (i == EXIT)   { if (dbg) printf("exit(%d) cycle = %d\n", *sp, cycle); return *sp; }
+    else if (i == LDL)  w = *(long long *)((a & amask) | abase);     // load long long
+    else if (i == LDD)  f = *(double *)((a & amask) | abase);        // load double
+    else if (i == STL)  *(long long *)((*sp++ & amask) | abase) = w; // store long long
+    else if (i == STD)  *(double *)((*sp++ & amask) | abase) = f;    // store double
+    else if (i == PSHL) { sp = sp - ws; *(long long *)sp = w; } // push long long
+    else if (i == PSHD) { sp = sp - ws; *(double *)sp = f; }    // push double
+    else if (i == ITL)  w = a;                                  // conversions between accumulators
+    else if (i == ITF)  f = a;
+    else if (i == LTI)  a = w;
+    else if (i == LTF)  f = w;
+    else if (i == FTI)  a = f;
+    else if (i == FTL)  w = f;
+
+    else if (i == LOR)  { w = *(long long *)sp |  w; sp = sp + ws; }
+    else if (i == LXOR) { w = *(long long *)sp ^  w; sp = sp + ws; }
+    else if (i == LAND) { w = *(long long *)sp &  w; sp = sp + ws; }
+    else if (i == LEQ)  { a = *(long long *)sp == w; sp = sp + ws; }
+    else if (i == LNE)  { a = *(long long *)sp != w; sp = sp + ws; }
+    else if (i == LLT)  { a = *(long long *)sp <  w; sp = sp + ws; }
+    else if (i == LGT)  { a = *(long long *)sp >  w; sp = sp + ws; }
+    else if (i == LLE)  { a = *(long long *)sp <= w; sp = sp + ws; }
+    else if (i == LGE)  { a = *(long long *)sp >= w; sp = sp + ws; }
+    else if (i == LSHL) { w = *(long long *)sp << w; sp = sp + ws; }
+    else if (i == LSHR) { w = *(long long *)sp >> w; sp = sp + ws; }
+    else if (i == LADD) { w = *(long long *)sp +  w; sp = sp + ws; }
+    else if (i == LSUB) { w = *(long long *)sp -  w; sp = sp + ws; }
+    else if (i == LMUL) { w = *(long long *)sp *  w; sp = sp + ws; }
+    else if (i == LDIV) { w = *(long long *)sp /  w; sp = sp + ws; }
+    else if (i == LMOD) { w = *(long long *)sp %  w; sp = sp + ws; }
+
+    else if (i == FEQ)  { a = *(double *)sp == f; sp = sp + ws; }
+    else if (i == FNE)  { a = *(double *)sp != f; sp = sp + ws; }
+    else if (i == FLT)  { a = *(double *)sp <  f; sp = sp + ws; }
+    else if (i == FGT)  { a = *(double *)sp >  f; sp = sp + ws; }
+    else if (i == FLE)  { a = *(double *)sp <= f; sp = sp + ws; }
+    else if (i == FGE)  { a = *(double *)sp >= f; sp = sp + ws; }
+    else if (i == FADD) { f = *(double *)sp +  f; sp = sp + ws; }
+    else if (i == FSUB) { f = *(double *)sp -  f; sp = sp + ws; }
+    else if (i == FMUL) { f = *(double *)sp *  f; sp = sp + ws; }
+    else if (i == FDIV) { f = *(double *)sp /  f; sp = sp + ws; }
+
+    // library calls: pointer arguments are masked, lengths checked against the end of the sandbox
+    else if (i == OPEN)   {
+      if (sbx) { printf("sandbox violation: open! cycle = %d\n", cycle); return -1; }
+      a = open((char *)*sp, sp[1], sp[2]);
+    }
+    else if (i == READ || i == WRITE) {
+      sp[1] = (sp[1] & amask) | abase;
+      if (sbx && (*sp < 0 || *sp > 2)) { printf("sandbox violation: %s on fd %d! cycle = %d\n", &ops[i * 8], *sp, cycle); return -1; }
+      if (sbx && (sp[2] < 0 || sp[2] > abase + BoxSz - sp[1])) { printf("sandbox violation: %s out of bounds! cycle = %d\n", &ops[i * 8], cycle); return -1; }
+      a = (i == READ) ? read(*sp, (char *)sp[1], sp[2]) : write(*sp, (char *)sp[1], sp[2]);
+    }
+    else if (i == CLOSE)  {
+      if (sbx) { printf("sandbox violation: close! cycle = %d\n", cycle); return -1; }
+      a = close(*sp);
+    }
+    else if (i == PRINTF) {
+      *sp = (*sp & amask) | abase;
+      if (sbx) { // mask %s arguments; refuse conversions other than d i u x X o c s f e g E G p %, lengths on %s, positional arguments and more arguments than passed
+        t = (char *)*sp;
+        while ((int)t < abase + BoxSz && *t) ++t;
+        if ((int)t == abase + BoxSz) { printf("sandbox violation: printf format out of bounds! cycle = %d\n", cycle); return -1; }
+        t = (char *)*sp; q = sp + 1;
+        while (*t) {
+          if (*t++ == '%') {
+            sz = 1; i = 0;
+            while ((*t >= '0' && *t <= '9') || *t == '-' || *t == '+' || *t == ' ' || *t == '#' || *t == '\'' || *t == 'I' || *t == '.' || *t == '*' || *t == '$' ||
+                   *t == 'h' || *t == 'l' || *t == 'q' || *t == 'j' || *t == 'z' || *t == 't') { // flags, width, precision and lengths but long double
+              if (*t == '$') { printf("sandbox violation: positional argument in printf! cycle = %d\n", cycle); return -1; }
+              if (*t == '*') ++q; else if ((*t == 'l' && t[1] == 'l') || *t == 'q' || *t == 'j') sz = ws;
+              if (*t >= 'a' && *t <= 'z') i = 1; // length
+              ++t;
+            }
+            if (*t != 'd' && *t != 'i' && *t != 'u' && *t != 'x' && *t != 'X' && *t != 'o' && *t != 'c' && *t != 's' &&
+                *t != 'f' && *t != 'e' && *t != 'g' && *t != 'E' && *t != 'G' && *t != 'p' && *t != '%' || (*t == 's' && i)) { printf("sandbox violation: bad printf conversion! cycle = %d\n", cycle); return -1; }
+            if (*t == 's' && q < sp + 8) *q = (*q & amask) | abase;
+            if (*t == 'f' || *t == 'e' || *t == 'g' || *t == 'E' || *t == 'G') sz = ws;
+            if (*t && *t++ != '%') q = q + sz;
+            if (q > sp + 8) { printf("sandbox violation: too many printf arguments! cycle = %d\n", cycle); return -1; }
+          }
+        }
+      }
+      a = printf((char *)*sp, sp[1], sp[2], sp[3], sp[4], sp[5], sp[6], sp[7]);
+    }
+    else if (i == SCANF)  {
+      if (sbx) { printf("sandbox violation: scanf! cycle = %d\n", cycle); return -1; }
+      a = scanf((char *)*sp, sp[1], sp[2], sp[3], sp[4], sp[5], sp[6], sp[7]);
+    }
+    else if (i == MALLOC) { // small blocks from their size class free list or the current chunk, big blocks get a chunk of their own
+      sz = *sp; a = i = 0;
+      while (i < Classes && (MinSz << i) < sz) ++i;
+      if (!bmp && i < Classes && fl[i]) { // the link lives in a freed block the program can still write, mask it
+        a = (fl[i] & amask & -sizeof(int)) | abase; fl[i] = *(int *)a;
+        if (fl[i]) fl[i] = (fl[i] & amask & -sizeof(int)) | abase;
+      }
+      else if (sz >= 0) {
+        if (i < Classes && !bmp) sz = MinSz << i;
+        sz = (sz + sizeof(int) - 1) & -sizeof(int);
+        if (!bmp) sz = sz + sizeof(int); // size class header
+        if (i == Classes || hp + sz > he) { // new chunk linked into the chain (inside the sandbox it is carved from the data arena)
+          hs = (i == Classes) ? sz + sizeof(int) : HeapSz;
+          if (!sbx) hq = malloc(hs);
+          else if (hs < 0 || hs > (char *)stack - d) hq = 0;
+          else { hq = (int *)d; d = d + hs; }
+          if (hq) {
+            *hq = (int)hc; hc = hq;
+            if (i == Classes) a = (int)(hq + 1); else { hp = (char *)(hq + 1); he = (char *)hq + HeapSz; }
+          }
+        }
+        if (i < Classes && hp + sz <= he) { a = (int)hp; hp = hp + sz; }
+        if (a && !bmp) { *(int *)a = i; a = a + sizeof(int); }
+      }
+    }
+    else if (i == FREE)   { // small blocks go back to their free list, big chunks are unlinked and released
+      if (*sp && !bmp) {
+        hq = (int *)(((*sp - sizeof(int)) & amask & -sizeof(int)) | abase); i = *hq;
+        if (i >= 0 && i < Classes) { hq[1] = fl[i]; fl[i] = (int)(hq + 1); }
+        else if (i == Classes && !sbx) {
+          --hq; q = (int *)&hc;
+          while (*q && *q != (int)hq) q = (int *)*q;
+          if (*q) { *q = *hq; free(hq); }
+        }
+      }
+    }
+    else if (i == MEMSET || i == MEMCMP || i == MEMCPY) {
+      *sp = (*sp & amask) | abase;
+      if (i != MEMSET) sp[1] = (sp[1] & amask) | abase;
+      if (sbx && (sp[2] < 0 || sp[2] > abase + BoxSz - *sp || (i != MEMSET && sp[2] > abase + BoxSz - sp[1]))) { printf("sandbox violation: %s out of bounds! cycle = %d\n", &ops[i * 8], cycle); return -1; }
+      if (i == MEMSET) a = (int)memset((char *)*sp, sp[1], sp[2]);
+      else if (i == MEMCMP) a = memcmp((char *)*sp, (char *)sp[1], sp[2]);
+      else a = (int)memcpy((char *)*sp, (char *)sp[1], sp[2]);
+    }
+    else if (i == SBRK)   {
+      a = (int)d; d = d + *sp;
+      if (sbx && (d < data || d > (char *)stack)) { d = (char *)a; a = -1; }
+    }
+    else if (i == BRK)    {
+      if (sbx && ((char *)*sp < data || (char *)*sp > (char *)stack)) a = -1;
+      else { d = (char *)*sp; a = 0; }
+    }
+    else if (i == EXIT)   {
+      if (dbg) printf("exit(%d) cycle = %d\n", *sp, cycle);
+      if (prof) { // write the sampled stacks root first in the collapsed format of flamegraph.pl
+        if ((sz = open(prof, 577, 420)) < 0) printf("could not open(%s)\n", prof); // O_WRONLY | O_CREAT | O_TRUNC, 0644
+        else {
+          i = 0;
+          while (i < ProfB) {
+            hq = (int *)pb[i++];
+            while (hq) {
+              hs = hq[2];
+              while (hs--) { id = (int *)hq[3 + hs]; write(sz, (char *)id[Name], id[Len]); write(sz, hs ? ";" : " ", 1); }
+              t = (char *)ps + 15; *t = '\n'; a = hq[1];
+              while (a) { *--t = '0' + a % 10; a = a / 10; }
+              write(sz, t, (char *)ps + 16 - t);
+              hq = (int *)*hq;
+            }
+          }
+          close(sz);
+        }
+      }
+      if (!sbx) while (hc) { hq = hc; hc = (int *)*hc; free(hq); } // release the whole heap
+      free(fl);
+      return *sp;
+    }
 
     else { printf("unknown instruction = %d! cycle = %d\n", i, cycle); exit(-1); }
   }
@@ -620,26 +1043,43 @@ int main(int argc, char **argv) {
   --argc; ++argv;
   if (argc > 0 && **argv == '-' && (*argv)[1] == 's') { src = 1; --argc; ++argv; }
   if (argc > 0 && **argv == '-' && (*argv)[1] == 'd') { dbg = 1; --argc; ++argv; }
-  if (argc < 1) { printf("usage: c7 [-s] [-d] file ...\n"); return -1; }
+  if (argc > 0 && **argv == '-' && (*argv)[1] == 'b') { sbx = 1; --argc; ++argv; }
+  if (argc > 0 && **argv == '-' && (*argv)[1] == 'f') { bmp = 1; --argc; ++argv; }
+  if (argc > 1 && **argv == '-' && (*argv)[1] == 'p') { prof = argv[1]; argc = argc - 2; argv = argv + 2; }
+  if (argc < 1) { printf("usage: c8 [-s] [-d] [-b] [-f] [-p file] file ...\n"); return -1; }
 
   fn = *argv;
 
   if (dbg) printf("DBG: sizeof (int):%d SymSz:%d CodeSz:%d DataSz:%d StackSz:%d AstSz:%d SrcSz:%d\n", sizeof (int), SymSz, CodeSz, DataSz, StackSz, AstSz, SrcSz);
 
-  if (!(sym = malloc(SymSz))) { printf("FATAL: could not malloc(%d) symbol area\n", SymSz); return -1; }
-  memset(sym, 0, SymSz);
+  if (!(sym = malloc(SymSz * sizeof(int)))) { printf("FATAL: could not malloc(%d) symbol area\n", SymSz * sizeof(int)); return -1; }
+  memset(sym, 0, SymSz * sizeof(int));
   if (!(le = e = code = malloc(CodeSz))) { printf("FATAL: could not malloc(%d) code area\n", CodeSz); return -1; }
   memset(e, 0, CodeSz);
-  if (!(d = data = malloc(DataSz))) { printf("FATAL: could not malloc(%d) data area\n", DataSz); return -1; }
-  memset(d, 0, DataSz);
-  if (!(stack = malloc(StackSz))) { printf("FATAL: could not malloc(%d) stack area\n", StackSz); exit(-1); }
+  if (sbx) { // one size aligned region: data and heap from the bottom, stack at the top, zeroed guard bytes above
+    if (!(d = malloc(BoxSz + BoxSz + 16))) { printf("FATAL: could not malloc(%d) sandbox area\n", BoxSz + BoxSz + 16); return -1; }
+    d = data = (char *)(((int)d + BoxSz - 1) & -BoxSz);
+    memset(d, 0, BoxSz + 16);
+    stack = (int *)(data + BoxSz - StackSz);
+  }
+  else {
+    if (!(d = data = malloc(DataSz))) { printf("FATAL: could not malloc(%d) data area\n", DataSz); return -1; }
+    memset(d, 0, DataSz);
+    if (!(stack = malloc(StackSz))) { printf("FATAL: could not malloc(%d) stack area\n", StackSz); exit(-1); }
+  }
+  if (!(tsize = malloc(PTR * sizeof(int)))) { printf("FATAL: could not malloc() tsize area\n"); exit(-1); }
+  tsize[CHAR] = sizeof(char); tsize[INT] = sizeof(int); tsize[LONG] = sizeof(long long); tsize[DOUBLE] = sizeof(double);
+  ws = sizeof(double) / sizeof(int);
 
   ops = "IMM\0    LEA\0    JMP\0    JSR\0    BZ\0     BNZ\0    ENTER\0  ADJ\0    LEAVE\0  LI\0     LC\0     SI\0     SC\0     PUSH\0   "
         "OR\0     XOR\0    AND\0    EQ\0     NE\0     LT\0     GT\0     LE\0     GE\0     SHL\0    SHR\0    ADD\0    SUB\0    MUL\0    DIV\0    MOD\0    "
+        "LDL\0    LDD\0    STL\0    STD\0    PSHL\0   PSHD\0   ITL\0    ITF\0    LTI\0    LTF\0    FTI\0    FTL\0    "
+        "LOR\0    LXOR\0   LAND\0   LEQ\0    LNE\0    LLT\0    LGT\0    LLE\0    LGE\0    LSHL\0   LSHR\0   LADD\0   LSUB\0   LMUL\0   LDIV\0   LMOD\0   "
+        "FEQ\0    FNE\0    FLT\0    FGT\0    FLE\0    FGE\0    FADD\0   FSUB\0   FMUL\0   FDIV\0   "
         "OPEN\0   READ\0   WRITE\0  CLOSE\0  PRINTF\0 SCANF\0  MALLOC\0 FREE\0   MEMSET\0 MEMCMP\0 MEMCPY\0 SBRK\0   BRK\0    EXIT\0   ";
 
   line = 0;
-  lp = p = "char else enum if int return sizeof while "
+  lp = p = "char int long double else enum if return sizeof while "
            "open read write close printf scanf malloc free memset memcmp memcpy sbrk brk exit "
            "void main";
   i = Char; while (i <= While) { next(); id[Tk] = i++; } // add keywords to symbol table
@@ -649,7 +1089,5 @@ int main(int argc, char **argv) {
 
   parse();
 
-  free(sym); sym = 0;
-
   return run(argc, argv);
 }
@@ -7,3 +7,13 @@ done
 for fn in test/$1_*_fail.c; do
     ./$1 $fn arg_$fn && echo "$fn FAILED"
 done
+
+for fn in test/$1_*_sbxok.c; do
+    [ -e "$fn" ] || continue
+    ./$1 -b $fn arg_$fn && echo "$fn" || echo "$fn FAILED"
+done
+
+for fn in test/$1_*_sbxfail.c; do
+    [ -e "$fn" ] || continue
+    ./$1 -b $fn arg_$fn && echo "$fn FAILED"
+done
@@ -0,0 +1,25 @@
+int main() {
+  int *p, *q, *l, *n, i;
+  char *b;
+
+  // small blocks are recycled through their size class
+  p = malloc(3 * sizeof(int));
+  free(p);
+  q = malloc(4 * sizeof(int));
+  if (p != q) { printf("size class block not recycled! p:%p q:%p\n", p, q); exit(-1); }
+  free(q);
+
+  // a list of many small nodes
+  l = 0; i = 0;
+  while (i < 10000) { n = malloc(2 * sizeof(int)); n[0] = (int)l; n[1] = i; l = n; ++i; }
+  while (l) { --i; if (l[1] != i) { printf("list node %d corrupted! : %d\n", i, l[1]); exit(-1); } n = (int *)*l; free(l); l = n; }
+
+  // big blocks get a chunk of their own
+  b = malloc(100000);
+  memset(b, 'x', 100000);
+  p = malloc(sizeof(int)); *p = 4711;
+  if (b[99999] != 'x' || *p != 4711) { printf("big block overlaps! %d %d\n", b[99999], *p); exit(-1); }
+  free(b);
+  free(p);
+  return 0;
+}
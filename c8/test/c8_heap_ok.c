@@ -0,0 +1,36 @@
+int main() {
+  int *p, *q, *l, *n, i;
+  long long *w;
+  double *d;
+  char *b;
+
+  // small blocks are recycled through their size class
+  p = malloc(3 * sizeof(int));
+  free(p);
+  q = malloc(4 * sizeof(int));
+  if (p != q) { printf("size class block not recycled! p:%p q:%p\n", p, q); exit(-1); }
+  free(q);
+
+  // a list of many small nodes
+  l = 0; i = 0;
+  while (i < 10000) { n = malloc(2 * sizeof(int)); n[0] = (int)l; n[1] = i; l = n; ++i; }
+  while (l) { --i; if (l[1] != i) { printf("list node %d corrupted! : %d\n", i, l[1]); exit(-1); } n = (int *)*l; free(l); l = n; }
+
+  // long long and double blocks keep their values across recycling
+  w = malloc(4 * sizeof(long long)); w[3] = (long long)1 << 40;
+  free(w);
+  d = malloc(4 * sizeof(double)); d[0] = 0.5; d[3] = 2.25;
+  if ((int *)d != (int *)w) { printf("wide block not recycled! w:%p d:%p\n", w, d); exit(-1); }
+  w = malloc(4 * sizeof(long long)); w[3] = 7;
+  if (d[3] != 2.25 || d[0] != 0.5 || w[3] != 7) { printf("wide blocks overlap!\n"); exit(-1); }
+  free(d); free(w);
+
+  // big blocks get a chunk of their own
+  b = malloc(100000);
+  memset(b, 'x', 100000);
+  p = malloc(sizeof(int)); *p = 4711;
+  if (b[99999] != 'x' || *p != 4711) { printf("big block overlaps! %d %d\n", b[99999], *p); exit(-1); }
+  free(b);
+  free(p);
+  return 0;
+}
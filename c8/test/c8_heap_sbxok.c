@@ -0,0 +1,14 @@
+int main() {
+  int *p, *q, *r;
+
+  // a link overwritten after free is masked into the sandbox instead of reaching the host
+  p = malloc(8);
+  free(p);
+  *p = 200000000;
+  q = malloc(8);
+  r = malloc(8);
+  if (q != p) { printf("freed block not recycled! p:%p q:%p\n", p, q); exit(-1); }
+  *r = 4711;
+  if (*r != 4711) { printf("masked block store/load mismatch!\n"); exit(-1); }
+  return 0;
+}
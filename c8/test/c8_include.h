@@ -0,0 +1,12 @@
+#ifndef C8_INCLUDE_H
+#define C8_INCLUDE_H
+
+#define ANSWER 42
+#define TWICE_ANSWER (ANSWER + ANSWER)
+#define GREETING "hello"
+
+int square(int x) {
+  return x * x;
+}
+
+#endif
@@ -0,0 +1,3 @@
+#if defined(DEBUG) // only integer constants
+int main() { return 0; }
+#endif
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include "c8_include.h"
+#include "c8_include.h" // guarded: the second include is a no-op
+
+#define DEBUG
+#define int int // self-referential: expanded once, then the keyword
+
+int main() {
+  int i;
+
+  if (ANSWER != 42) { printf("ANSWER != 42! : %d\n", ANSWER); exit(-1); }
+  if (TWICE_ANSWER * 2 != 168) { printf("TWICE_ANSWER * 2 != 168! : %d\n", TWICE_ANSWER * 2); exit(-1); }
+  if (memcmp(GREETING, "hello", 6)) { printf("GREETING != \"hello\"! : %s\n", GREETING); exit(-1); }
+  if (square(ANSWER) != 1764) { printf("square(ANSWER) != 1764! : %d\n", square(ANSWER)); exit(-1); }
+
+  i = 0;
+#ifdef DEBUG
+  i = i + 1;
+#ifdef UNDEFINED
+  i = i + 10;
+#else
+  i = i + 100;
+#endif
+#else
+  i = i + 1000;
+#endif
+#ifndef DEBUG
+  i = i + 10000;
+#endif
+  if (i != 101) { printf("conditional groups: i != 101! : %d\n", i); exit(-1); }
+
+  i = 0;
+#if 0
+  i = i + 1;
+#else
+  i = i + 10;
+#endif
+#if 1
+  i = i + 100;
+#endif
+  if (i != 110) { printf("#if groups: i != 110! : %d\n", i); exit(-1); }
+
+  i = 0;
+#include "c8_include_twice.h"
+#include "c8_include_twice.h"
+  if (i != 2) { printf("unguarded header not included twice: i != 2! : %d\n", i); exit(-1); }
+  return 0;
+}
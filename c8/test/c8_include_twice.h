@@ -0,0 +1 @@
+i = i + 1; // no include guard: every #include reads this again
@@ -0,0 +1,4 @@
+int main() {
+  write(3, "x", 1); // only stdin, stdout and stderr
+  return 0;
+}
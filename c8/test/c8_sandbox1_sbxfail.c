@@ -0,0 +1,6 @@
+int main() {
+  char *p;
+  p = malloc(16);
+  memset(p, 0, 1 << 30); // beyond the end of the sandbox
+  return 0;
+}
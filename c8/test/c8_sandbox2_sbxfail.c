@@ -0,0 +1,10 @@
+int smash() {
+  int x;
+  *(&x + 2) = 4711; // overwrite return address
+  return 0;
+}
+
+int main() {
+  smash();
+  return 0;
+}
@@ -0,0 +1,5 @@
+int main() {
+  int x;
+  printf("%1$n", &x); // positional conversions escape the argument scan
+  return 0;
+}
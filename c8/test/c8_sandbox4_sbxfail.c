@@ -0,0 +1,5 @@
+int main() {
+  int x;
+  printf("%d %d %d %d %d %d %d %n", 1, 2, 3, 4, 5, 6, 7, &x); // %n after the last passed argument
+  return 0;
+}
@@ -0,0 +1,4 @@
+int main() {
+  printf("%zn", 4096); // the length modifier must not hide %n
+  return 0;
+}
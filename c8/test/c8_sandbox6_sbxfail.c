@@ -0,0 +1,4 @@
+int main() {
+  printf("%'n", 4096); // nor a flag
+  return 0;
+}
@@ -0,0 +1,4 @@
+int main() {
+  printf("%zs", 4096); // a length on %s is refused
+  return 0;
+}
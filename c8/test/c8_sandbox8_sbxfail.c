@@ -0,0 +1,4 @@
+int main() {
+  open("/etc/passwd", 0); // host files are out of reach
+  return 0;
+}
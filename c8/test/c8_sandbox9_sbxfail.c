@@ -0,0 +1,4 @@
+int main() {
+  close(3); // as are the fds of the host process
+  return 0;
+}
@@ -0,0 +1,18 @@
+int main(int argc, char **argv) {
+  char *p, *q;
+  int *w;
+
+  if (memcmp(argv[1], "arg_test/c8_sandbox_sbxok.c", 27)) { printf("argv[1] not copied into sandbox!\n"); exit(-1); }
+  p = malloc(16); q = malloc(16);
+  if (!p || !q || q - p < 16) { printf("bad sandbox malloc! p:%p q:%p\n", p, q); exit(-1); }
+  memcpy(p, "sandbox", 8);
+  memcpy(q, p, 8);
+  printf("%s %d %s\n", q, 42, "ok");
+  free(p); free(q);
+
+  // wild pointers are masked into the sandbox instead of hitting the host
+  w = (int *)12345;
+  *w = 4711;
+  if (*w != 4711) { printf("masked store/load mismatch!\n"); exit(-1); }
+  return 0;
+}
@@ -0,0 +1,69 @@
+long long lg;
+double dg;
+
+double half(double x) {
+  return x / 2;
+}
+
+long long lmul(long long x, int i, double y) {
+  return x * i + (long long)y;
+}
+
+int main() {
+  long long l, *pl;
+  double d, *pd;
+  int i;
+
+  if (sizeof(long long) != 8) { printf("sizeof(long long) != 8! : %d\n", sizeof(long long)); exit(-1); }
+  if (sizeof(double) != 8) { printf("sizeof(double) != 8! : %d\n", sizeof(double)); exit(-1); }
+
+  // long long arithmetic
+  l = 1;
+  l = l << 40;
+  if ((int)(l >> 32) != 256) { printf("(l >> 32) != 256! : %d\n", (int)(l >> 32)); exit(-1); }
+  l = l + 5;
+  if (l % 16 != 5) { printf("l %% 16 != 5! : %d\n", (int)(l % 16)); exit(-1); }
+  if (!(l > 1000000000)) { printf("l > 1000000000 failed!\n"); exit(-1); }
+  lg = 1000000 * (long long)1000000;
+  if (lg / 1000000 != 1000000) { printf("lg / 1000000 != 1000000!\n"); exit(-1); }
+  pl = malloc(3 * sizeof(long long)); pl[1] = -3; ++pl;
+  if (*pl != -3) { printf("*pl != -3! : %d\n", (int)*pl); exit(-1); }
+  i = 0; l = 0;
+  while (l < 10) { l++; ++i; }
+  if (i != 10) { printf("long long loop: i != 10! : %d\n", i); exit(-1); }
+  if (lmul((long long)7, 6, 0.5) != 42) { printf("lmul(7, 6, 0.5) != 42!\n"); exit(-1); }
+
+  // double arithmetic
+  d = 1.5;
+  d = d * 4 - 0.5;
+  if (d != 5.5) { printf("d != 5.5! : %d\n", (int)(d * 1000)); exit(-1); }
+  if ((int)(d * 2) != 11) { printf("(int)(d * 2) != 11! : %d\n", (int)(d * 2)); exit(-1); }
+  dg = 1e3;
+  if (dg != 1000) { printf("dg != 1000! : %d\n", (int)dg); exit(-1); }
+  if (half(3.0) != 1.5) { printf("half(3.0) != 1.5!\n"); exit(-1); }
+  pd = malloc(3 * sizeof(double)); pd[2] = 0.25; pd = pd + 2;
+  if (*pd * 8 != 2) { printf("*pd * 8 != 2!\n"); exit(-1); }
+  d = -d;
+  if (d >= 0 || !(d < -5)) { printf("d = -d failed! : %d\n", (int)d); exit(-1); }
+  d = 0.0;
+  if (d) { printf("0.0 is true!\n"); exit(-1); }
+  i = 0;
+  while (d < 1) { d = d + 0.125; ++i; }
+  if (i != 8) { printf("double loop: i != 8! : %d\n", i); exit(-1); }
+
+  // mixed
+  l = 3; d = l;
+  if (d / 2 != 1.5) { printf("d / 2 != 1.5!\n"); exit(-1); }
+  i = d * l;
+  if (i != 9) { printf("i != 9! : %d\n", i); exit(-1); }
+  i = 1;
+  d = i ? 1 : 2.5;
+  if (d != 1) { printf("i ? 1 : 2.5 != 1! : %d\n", (int)d); exit(-1); }
+  d = !i ? 1 : 2.5;
+  if (d != 2.5) { printf("!i ? 1 : 2.5 != 2.5!\n"); exit(-1); }
+  d = i ? l : 0.5;
+  if (d != 3) { printf("i ? l : 0.5 != 3!\n"); exit(-1); }
+  l = i ? 7 : l;
+  if (l != 7) { printf("i ? 7 : l != 7! : %d\n", (int)l); exit(-1); }
+  return 0;
+}
@@ -1,60 +1,449 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "cc.h"
 
+// tokens and classes, keywords, operators (in precedence order) and further AST node kinds
 enum Token {
-  Num = 128, Local, Global, Func, Enum, Struct, Member, Id,
-  AutoKW, CharKW, EnumKW, IntKW, StructKW, VoidKW
+  Num = 128, Str, Local, Global, Func, Sys, Enum, Struct, Member, Id,
+  AutoKW, CharKW, ElseKW, EnumKW, IfKW, IntKW, ReturnKW, SizeofKW, StructKW, VoidKW, WhileKW,
+  Assign, Cond, Lor, Land, Or, Xor, And, Eq, Ne, Lt, Gt, Le, Ge, Shl, Shr, Add, Sub, Mul, Div, Mod, Inc, Dec, Dot, Arrow, Bracket,
+  Load, Cast, Block
 };
 
 const char* tokens[] = {
-  "number", "local variable", "global variable", "function", "enumeration", "structure", "identifier",
-  "keyword 'auto'", "keyword 'char'", "keyword 'enum'", "keyword 'int'", "keyword 'struct'", "keyword 'void'"
+  "number", "string", "local variable", "global variable", "function", "library function", "enumeration", "structure", "member", "identifier",
+  "keyword 'auto'", "keyword 'char'", "keyword 'else'", "keyword 'enum'", "keyword 'if'", "keyword 'int'",
+  "keyword 'return'", "keyword 'sizeof'", "keyword 'struct'", "keyword 'void'", "keyword 'while'",
+  "'='", "'?'", "'||'", "'&&'", "'|'", "'^'", "'&'", "'=='", "'!='", "'<'", "'>'", "'<='", "'>='", "'<<'", "'>>'",
+  "'+'", "'-'", "'*'", "'/'", "'%'", "'++'", "'--'", "'.'", "'->'", "'['",
+  "load", "cast", "block"
 };
 
 struct Identifier {
   Identifier* next; // next in list
+  Identifier* link; // next in hash bucket
+  int scope;        // scope level of declaration; 0 is global
   Token tok;        // see enum Token
   const char* str;  // name of identifier; may be 0 for unnamed enum or struct
   int hash;         // hash of identifier name
   int line;         // line number
   int ptr;          // Local, Global, Func, Member: level of indirection
   Identifier* ref;  // Local, Global, Func, Member: type; Enum, Struct: member list
-  int val;          // Num: value; Local, Global, Func, Member: offset; Enum, Struct: size in bytes
+  int val;          // Num: value; Local, Global, Member: offset; Func: function index; Sys: library index; Enum, Struct: size in bytes
 };
 
-int tok;          // current token
-Identifier* id;   // currently parsed identifier
-int line;         // current line number
-int val;          // currently parsed integer value
-Identifier* kws;  // keyword list
-Identifier* ids;  // global identifier list
-int enums;        // number of enums
-int structs;      // number of structs
+// opcodes of the c8 VM (IMM...ADJ have parameter); cc emits the int and library subset
+enum {
+  IMM, LEA, JMP, JSR, BZ, BNZ, ENTER, ADJ, LEAVE, LI, LC, SI, SC, PUSH,
+  OR, XOR, AND, EQ, NE, LT, GT, LE, GE, SHL, SHR, ADD, SUB, MUL, DIV, MOD,
+  LDL, LDD, STL, STD, PSHL, PSHD, ITL, ITF, LTI, LTF, FTI, FTL,
+  LOR, LXOR, LAND, LEQ, LNE, LLT, LGT, LLE, LGE, LSHL, LSHR, LADD, LSUB, LMUL, LDIV, LMOD,
+  FEQ, FNE, FLT, FGT, FLE, FGE, FADD, FSUB, FMUL, FDIV,
+  OPEN, READ, WRITE, CLOSE, PRINTF, SCANF, MALLOC, FREE, MEMSET, MEMCMP, MEMCPY, SBRK, BRK, EXIT
+};
+
+const char* ops =
+  "IMM\0    LEA\0    JMP\0    JSR\0    BZ\0     BNZ\0    ENTER\0  ADJ\0    LEAVE\0  LI\0     LC\0     SI\0     SC\0     PUSH\0   "
+  "OR\0     XOR\0    AND\0    EQ\0     NE\0     LT\0     GT\0     LE\0     GE\0     SHL\0    SHR\0    ADD\0    SUB\0    MUL\0    DIV\0    MOD\0    "
+  "LDL\0    LDD\0    STL\0    STD\0    PSHL\0   PSHD\0   ITL\0    ITF\0    LTI\0    LTF\0    FTI\0    FTL\0    "
+  "LOR\0    LXOR\0   LAND\0   LEQ\0    LNE\0    LLT\0    LGT\0    LLE\0    LGE\0    LSHL\0   LSHR\0   LADD\0   LSUB\0   LMUL\0   LDIV\0   LMOD\0   "
+  "FEQ\0    FNE\0    FLT\0    FGT\0    FLE\0    FGE\0    FADD\0   FSUB\0   FMUL\0   FDIV\0   "
+  "OPEN\0   READ\0   WRITE\0  CLOSE\0  PRINTF\0 SCANF\0  MALLOC\0 FREE\0   MEMSET\0 MEMCMP\0 MEMCPY\0 SBRK\0   BRK\0    EXIT\0   ";
+
+// library functions: name, opcode, number of parameters (at least, if variadic), return type
+struct Library {
+  const char* name;
+  int op;
+  int params;
+  int variadic;
+  const char* type; // "char", "int" or "void"
+  int ptr;
+};
+
+const Library library[] = {
+  { "open", OPEN, 2, 1, "int", 0 },
+  { "read", READ, 3, 0, "int", 0 },
+  { "write", WRITE, 3, 0, "int", 0 },
+  { "close", CLOSE, 1, 0, "int", 0 },
+  { "printf", PRINTF, 1, 1, "int", 0 },
+  { "malloc", MALLOC, 1, 0, "void", 1 },
+  { "free", FREE, 1, 0, "void", 0 },
+  { "memset", MEMSET, 3, 0, "void", 1 },
+  { "memcmp", MEMCMP, 3, 0, "int", 0 },
+  { "memcpy", MEMCPY, 3, 0, "void", 1 },
+  { "exit", EXIT, 1, 0, "void", 0 }
+};
+
+// lexer and parser state is per thread: function bodies are compiled by workers (see compile)
+thread_local int tok;          // current token
+thread_local Identifier* id;   // currently parsed identifier
+thread_local int line;         // current line number
+thread_local int val;          // currently parsed integer value; Str: offset of the string in strs
+thread_local int enums;        // number of enums
+thread_local int structs;      // number of structs
+thread_local const char* p;    // current position in source code
+thread_local int braces;       // nesting level of the braces lexed so far
+Identifier* intid;   // type int
+Identifier* charid;  // type char
+Identifier* voidid;  // type void
+
+// data segment: global variables, then the string literals of the workers
+char* data;       // contents, zero where not initialized
+int datasz;       // used size in bytes
+int maxdata;      // capacity of data
+
+// string literals of the thread, appended to the data segment by merge()
+thread_local char* strs;     // contents
+thread_local int nstrs;      // used size in bytes
+thread_local int maxstrs;    // capacity of strs
+
+// abstract syntax tree of the thread: struct of arrays indexed by node number; node 0 stands for no node
+thread_local int nodes;           // number of nodes
+thread_local int maxnodes;        // capacity of the node arrays
+thread_local unsigned char* nkind; // node kind: Num, Str, Local, Global, Func, Sys, Load, Cast, Block, statement keyword or operator; offset by Num
+thread_local int* na;             // Num: value; Str: strs offset; Global: data offset; Local: frame offset; Func: function index; Sys: library index; else first child
+thread_local int* nb;             // second child; Func, Sys: first argument
+thread_local int* nc;             // third child
+thread_local int* nnext;          // next node in a block or argument list
+thread_local int* nptr;           // type of the node: level of indirection
+thread_local Identifier** ntype;  // type of the node: char, int, void, enum or struct
+thread_local int* nline;          // line number
 
-static int get_hash(const char* str) {
-  int h = *str;
-  while (*str) h = h * 131 + *str++;
-  return (h << 6) + strlen(str);
+// functions of the module; the val of a Func identifier is its index
+struct Function {
+  Identifier* id;   // function name
+  const char* src;  // source behind the '(' of the definition; 0 if only declared
+  int line;         // line number of src
+  int body;         // root node of the body in the AST of its worker
+  int params;       // number of parameters
+  int frame;        // number of local variable slots
+  int code;         // code index of the function; in the code of its worker until merged
+  int end;          // code index behind the function
+  int worker;       // index of the worker that compiled the function
+  int reloc;        // first string relocation of the function in the list of its worker
+  int nrelocs;      // number of string relocations of the function
+};
+
+Function* funcs;  // functions in order of declaration
+int nfuncs;       // number of functions
+int maxfuncs;     // capacity of funcs
+thread_local int fn;     // index of the function being parsed
+thread_local int locals; // frame offset of the last local variable of the function being parsed
+int src;          // print generated code flag
+int jobs = 1;     // number of workers
+
+// identifiers and their names live in a bump arena of chunks, freed at once in deinit
+enum { ChunkSz = 64 * 1024 };
+
+struct Chunk {
+  Chunk* next;      // previously allocated chunk
+};
+
+thread_local Chunk* chunks;    // arena chunks of the thread, most recent first
+thread_local char* arena;      // free space in the current chunk
+thread_local char* arena_end;  // end of the current chunk
+
+// symbol table: hash buckets of identifiers, innermost declaration first;
+// read only while workers run, they add the identifiers of function bodies to their own ltable
+enum { HashSz = 4096 };
+
+Identifier* table[HashSz];
+thread_local Identifier** ltable;  // worker: buckets searched before table; 0 in the first pass
+thread_local Identifier** decls;   // identifiers declared in inner scopes, in order of declaration
+thread_local int ndecls;           // number of entries in decls
+thread_local int maxdecls;         // capacity of decls
+thread_local int scope;            // current scope level
+
+// diagnostics: errors go to the sink, one message per call; an embedder may replace it.
+// an error abandons the declaration or function being compiled, compilation resumes behind it
+static void print_diag(const char* msg) {
+  printf("%s\n", msg);
+}
+
+void (*cc_diag)(const char* msg) = print_diag;
+int errors;                     // number of errors reported
+std::mutex diag_lock;           // workers report concurrently
+thread_local jmp_buf* recover;  // where to resume after an error
+
+static void vreport(int l, const char* fmt, va_list ap) {
+  char msg[512];
+  int n = l ? sprintf(msg, "%d: ", l) : 0;
+  vsnprintf(msg + n, sizeof msg - n, fmt, ap);
+  diag_lock.lock();
+  ++errors;
+  cc_diag(msg);
+  diag_lock.unlock();
+}
+
+// report an error in line l (0: none) and go on
+static void report(int l, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vreport(l, fmt, ap);
+  va_end(ap);
+}
+
+// report an error in line l (0: none) and resume at the recovery point
+[[noreturn]] static void error(int l, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vreport(l, fmt, ap);
+  va_end(ap);
+  longjmp(*recover, 1);
+}
+
+// double the capacity of array a; the array is unchanged on error
+static void* grow(void* a, int* max, int size, const char* what) {
+  int m = *max ? 2 * *max : 256;
+  a = realloc(a, m * size);
+  if (!a) error(0, "FATAL: could not realloc(%d) %s", m * size, what);
+  *max = m;
+  return a;
+}
+
+static void* alloc(int size) {
+  size = (size + sizeof (void*) - 1) & -(int) sizeof (void*);
+  if (arena_end - arena < size) {
+    int sz = (int) sizeof (Chunk) + size;
+    if (sz < ChunkSz) sz = ChunkSz;
+    Chunk* b = (Chunk*) malloc(sz);
+    if (!b) error(0, "FATAL: could not malloc(%d) arena chunk", sz);
+    b->next = chunks; chunks = b;
+    arena = (char*) (b + 1); arena_end = (char*) b + sz;
+  }
+  void* p = arena;
+  arena += size;
+  return p;
+}
+
+static int get_hash(const char* str, int len) {
+  unsigned h = *str;
+  for (int i = 1; i < len; ++i) h = h * 131 + str[i];
+  return (h << 6) + len;
+}
+
+// bucket of a hash: the name hash above the 6 length bits, mixed with the length
+static int bucket(int hash) {
+  return ((hash >> 6) ^ hash) & (HashSz - 1);
 }
 
 static Identifier* new_id(Token tok, const char* str, int hash, int line) {
-  Identifier* i = (Identifier*) malloc(sizeof (Identifier));
+  Identifier* i = (Identifier*) alloc(sizeof (Identifier));
   memset(i, 0, sizeof (Identifier));
   i->tok = tok;
   i->str = str;
-  i->hash =hash;
+  i->hash = hash;
   i->line = line;
+  return i;
 }
 
-static Identifier* get_id(Identifier* list, const char* str, int hash) {
-  for (Identifier* i = list; i; i = i->next) {
-    if (i->hash = hash && !strcmp(i->str, str)) return i;
+// innermost visible identifier named str (len characters), or 0
+static Identifier* get_id(const char* str, int len, int hash) {
+  if (ltable) {
+    for (Identifier* i = ltable[bucket(hash)]; i; i = i->link) {
+      if (i->hash == hash && !memcmp(i->str, str, len) && !i->str[len]) return i;
+    }
+  }
+  for (Identifier* i = table[bucket(hash)]; i; i = i->link) {
+    if (i->hash == hash && !memcmp(i->str, str, len) && !i->str[len]) return i;
   }
   return 0;
 }
 
-static void next();
+// add identifier to its hash bucket in front of outer declarations of the same name
+static void add_id(Identifier* i) {
+  Identifier** b = &(ltable ? ltable : table)[bucket(i->hash)];
+  i->link = *b; *b = i;
+  if (i->scope) {
+    if (ndecls == maxdecls) decls = (Identifier**) grow(decls, &maxdecls, sizeof (Identifier*), "declaration stack");
+    decls[ndecls++] = i;
+  }
+}
+
+// remove identifier from its hash bucket, if it is still there
+static void remove_id(Identifier* i) {
+  Identifier** b = &(ltable ? ltable : table)[bucket(i->hash)];
+  while (*b && *b != i) b = &(*b)->link;
+  if (*b) *b = i->link;
+  i->link = 0;
+}
+
+// visible identifier named str; a new one with an interned copy of the name if there is none
+static Identifier* intern(const char* str, int len, int line) {
+  int h = get_hash(str, len);
+  Identifier* i = get_id(str, len, h);
+  if (!i) {
+    char* s = (char*) alloc(len + 1);
+    memcpy(s, str, len); s[len] = 0;
+    i = new_id(Id, s, h, line);
+    add_id(i);
+  }
+  return i;
+}
+
+// identifier to declare i's name in the current scope; shadows an outer declaration,
+// the global entry stays in the table and keeps the interned name
+static Identifier* declare(Identifier* i) {
+  if (i->scope != scope) {
+    Identifier* s = new_id(Id, i->str, i->hash, line);
+    s->scope = scope;
+    add_id(s);
+    i = s;
+  }
+  return i;
+}
+
+static void enter_scope() {
+  ++scope;
+}
+
+// drop identifiers declared in the current scope, making outer declarations visible again
+static void leave_scope() {
+  while (ndecls && decls[ndecls - 1]->scope == scope) {
+    remove_id(decls[--ndecls]);
+  }
+  --scope;
+}
+
+static const char* tok_name(int t) {
+  static thread_local char str[2][4];
+  static thread_local int i;
+  if (!t) return "end of file";
+  if (t >= Num) return tokens[t - Num];
+  i = !i;
+  sprintf(str[i], "'%c'", t);
+  return str[i];
+}
+
+static int node(int kind, int a, int b, int c, Identifier* type, int ptr) {
+  if (nodes == maxnodes) {
+    int m = maxnodes;
+    nkind = (unsigned char*) grow(nkind, &m, sizeof (unsigned char), "AST kinds"); m = maxnodes;
+    na = (int*) grow(na, &m, sizeof (int), "AST nodes"); m = maxnodes;
+    nb = (int*) grow(nb, &m, sizeof (int), "AST nodes"); m = maxnodes;
+    nc = (int*) grow(nc, &m, sizeof (int), "AST nodes"); m = maxnodes;
+    nnext = (int*) grow(nnext, &m, sizeof (int), "AST nodes"); m = maxnodes;
+    nptr = (int*) grow(nptr, &m, sizeof (int), "AST types"); m = maxnodes;
+    ntype = (Identifier**) grow(ntype, &m, sizeof (Identifier*), "AST types"); m = maxnodes;
+    nline = (int*) grow(nline, &m, sizeof (int), "AST lines");
+    maxnodes = m;
+  }
+  nkind[nodes] = kind - Num; na[nodes] = a; nb[nodes] = b; nc[nodes] = c; nnext[nodes] = 0;
+  ntype[nodes] = type; nptr[nodes] = ptr; nline[nodes] = line;
+  return nodes++;
+}
+
+static int kind(int n) {
+  return nkind[n] + Num;
+}
+
+// size in bytes of a value of the type; pointers are int sized
+static int size_of(Identifier* type, int ptr) {
+  return ptr ? sizeof (int) : type->val;
+}
+
+// zero filled space in the data segment, aligned to int
+static int data_alloc(int size) {
+  int o = (datasz + sizeof (int) - 1) & -(int) sizeof (int);
+  while (maxdata < o + size) data = (char*) grow(data, &maxdata, 1, "data segment");
+  memset(data + datasz, 0, o + size - datasz);
+  datasz = o + size;
+  return o;
+}
+
+static void next() {
+  const char* pp;
+  while ((tok = *p)) {
+    pp = p++;
+    if (tok == '\n') ++line;
+    else if (tok == ' ' || tok == '\t' || tok == '\r') ;
+    else if (tok == '#') { // preprocessor lines are ignored
+      while (*p && *p != '\n') ++p;
+    }
+    else if ((tok >= 'a' && tok <= 'z') || (tok >= 'A' && tok <= 'Z') || tok == '_') {
+      while ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_') ++p;
+      id = intern(pp, p - pp, line);
+      tok = (id->tok >= AutoKW && id->tok <= WhileKW) ? id->tok : Id;
+      return;
+    }
+    else if (tok >= '0' && tok <= '9') {
+      unsigned v; // wraps around like the VM's int
+      if ((v = tok - '0')) { while (*p >= '0' && *p <= '9') v = v * 10 + *p++ - '0'; }
+      else if (*p == 'x' || *p == 'X') {
+        while ((tok = *++p) && ((tok >= '0' && tok <= '9') || (tok >= 'a' && tok <= 'f') || (tok >= 'A' && tok <= 'F')))
+          v = v * 16 + (tok & 15) + (tok >= 'A' ? 9 : 0);
+      }
+      else { while (*p >= '0' && *p <= '7') v = v * 8 + *p++ - '0'; }
+      val = v;
+      tok = Num;
+      return;
+    }
+    else if (tok == '/') {
+      if (*p == '/') { while (*p && *p != '\n') ++p; }
+      else if (*p == '*') {
+        ++p;
+        while (*p && (*p != '*' || p[1] != '/')) { if (*p++ == '\n') ++line; }
+        if (*p) p += 2;
+      }
+      else { tok = Div; return; }
+    }
+    else if (tok == '\'' || tok == '"') {
+      int o = nstrs;
+      while (*p && *p != tok && *p != '\n') {
+        if ((val = *p++) == '\\') {
+          if ((val = *p++) == 'n') val = '\n';
+          else if (val == 't') val = '\t';
+          else if (val == '0') val = '\0';
+        }
+        if (tok == '"') {
+          if (nstrs == maxstrs) strs = (char*) grow(strs, &maxstrs, 1, "string literals");
+          strs[nstrs++] = val;
+        }
+      }
+      if (*p != tok) error(line, "unterminated %s literal", tok == '"' ? "string" : "character");
+      ++p;
+      if (tok == '"') {
+        if (nstrs == maxstrs) strs = (char*) grow(strs, &maxstrs, 1, "string literals");
+        strs[nstrs++] = 0;
+        val = o; tok = Str;
+      } else tok = Num;
+      return;
+    }
+    else if (tok == '=') { if (*p == '=') { ++p; tok = Eq;   } else tok = Assign; return; }
+    else if (tok == '+') { if (*p == '+') { ++p; tok = Inc;  } else tok = Add; return; }
+    else if (tok == '-') { if (*p == '-') { ++p; tok = Dec;  } else if (*p == '>') { ++p; tok = Arrow; } else tok = Sub; return; }
+    else if (tok == '!') { if (*p == '=') { ++p; tok = Ne;   } return; }
+    else if (tok == '<') { if (*p == '=') { ++p; tok = Le;   } else if (*p == '<') { ++p; tok = Shl; } else tok = Lt; return; }
+    else if (tok == '>') { if (*p == '=') { ++p; tok = Ge;   } else if (*p == '>') { ++p; tok = Shr; } else tok = Gt; return; }
+    else if (tok == '|') { if (*p == '|') { ++p; tok = Lor;  } else tok = Or; return; }
+    else if (tok == '&') { if (*p == '&') { ++p; tok = Land; } else tok = And; return; }
+    else if (tok == '^') { tok = Xor; return; }
+    else if (tok == '%') { tok = Mod; return; }
+    else if (tok == '*') { tok = Mul; return; }
+    else if (tok == '.') { tok = Dot; return; }
+    else if (tok == '[') { tok = Bracket; return; }
+    else if (tok == '?') { tok = Cond; return; }
+    else if (tok == '{') { ++braces; return; }
+    else if (tok == '}') { if (braces) --braces; return; }
+    else if (tok == '~' || tok == ';' || tok == '(' || tok == ')' || tok == ']' || tok == ',' || tok == ':') return;
+    else error(line, "bad character '%c'", tok);
+  }
+}
+
+static void expect(int t, const char* where) {
+  if (tok != t) error(line, "%s expected %s, got %s", tok_name(t), where, tok_name(tok));
+  next();
+}
+
+static int expr(int lev);
 
 static Identifier* enum_decl() {
   Identifier* type = 0;
@@ -63,53 +452,66 @@ static Identifier* enum_decl() {
   if (tok == Id) { // named enum?
     type = id;
     next();
+    if (tok != ';' && tok != '{') { // use of a declared enum
+      if (type->tok != Enum) { error(l, "enum name expected; '%s' is %s", type->str, tokens[type->tok - Num]); }
+      return type;
+    }
+    type = declare(type);
   }
   if (tok ==';') { // enum declaration?
     if (!type) {
-      printf("%d: bad enum declaration; enum name expected, got ';'\n", l); exit(-1);
+      error(l, "bad enum declaration; enum name expected, got ';'");
     } else if (type->tok == Enum) {
-      printf("%d: duplicate enum declaration; enum name '%s' already declared in line %d\n", l, type->str, type->line); exit(-1);
+      error(l, "duplicate enum declaration; enum name '%s' already declared in line %d", type->str, type->line);
     } else if (type->tok != Id) {
-      printf("%d: bad enum declaration; enum name '%s' already declared in line %d as %s\n", l, type->str, type->line, tokens[id->tok - Num]); exit(-1);
+      error(l, "bad enum declaration; enum name '%s' already declared in line %d as %s", type->str, type->line, tokens[type->tok - Num]);
     } type->tok = Enum;
     type->val = sizeof(int);
+    type->line = l;
   }
   else if (tok == '{') { // enum definition?
     if (type) {
       if (type->tok == Enum) {
-        printf("%d: duplicate enum definition; enum name '%s' already declared in line %d\n", l, type->str, type->line); exit(-1);
+        error(l, "duplicate enum definition; enum name '%s' already declared in line %d", type->str, type->line);
       } else if (type->tok != Id) {
-        printf("%d: bad enum definition; enum name '%s' already declared in line %d as %s\n", l, type->str, type->line, tokens[id->tok - Num]); exit(-1);
+        error(l, "bad enum definition; enum name '%s' already declared in line %d as %s", type->str, type->line, tokens[type->tok - Num]);
       }
     } else {
       char str[32];
       sprintf(str, "__unnamed_enum_%04X", enums);
-      int h = get_hash(str);
-      type = new_id(Id, str, l, h); type->next = ids; ids = type;
+      type = declare(intern(str, strlen(str), l));
     }
     ++enums;
     type->tok = Enum;
     type->val = sizeof(int);
+    type->line = l;
     next();
     int i = 0;
     while (tok !='}') {
       Identifier* name;
-      if (tok != Id) { printf("%d: bad enum definition; enumerator identifier expected\n", line); exit(-1); }
-      name = id; ids = name->next; name->next = 0; // remove id from global identifier list
+      if (tok != Id) { error(line, "bad enum definition; enumerator identifier expected, got %s", tok_name(tok)); }
+      name = declare(id);
+      if (name->tok != Id) { error(line, "bad enum definition; enumerator '%s' already declared in line %d as %s", name->str, name->line, tokens[name->tok - Num]); }
+      name->line = line;
       next();
-      if (tok == '=') {
-        next();
-        if (tok != Num) { printf("%d: bad enumerator initializer; number expected, got %s\n", line, tokens[id->tok - Num]); exit(-1); }
-        i = val;
+      if (tok == Assign) {
         next();
+        int n = expr(Cond);
+        if (kind(n) != Num) { error(line, "bad enumerator initializer; constant expected"); }
+        i = na[n];
       }
-      name->tok = Num; name->val = i++;
+      name->tok = Num; name->val = i++; name->ref = type;
       name->next = type->ref; type->ref = name; // add id to member list
+      if (tok == ',') next();
+      else if (tok != '}') { error(line, "bad enum definition; ',' or '}' expected, got %s", tok_name(tok)); }
     }
-  } else { printf("%d: enum declaration or definition expected, got %s\n", l, tokens[id->tok - Num]); exit(-1); }
+    next();
+  } else error(l, "enum declaration or definition expected, got %s", tok_name(tok));
   return type;
 }
 
+static Identifier* decl();
+
 Identifier* struct_decl() {
   Identifier* type = 0;
   int l = line; // save struct line number
@@ -117,59 +519,82 @@ Identifier* struct_decl() {
   if (tok == Id) { // named struct?
     type = id;
     next();
+    if (tok != ';' && tok != '{') { // use of a declared struct
+      if (type->tok != Struct) { error(l, "struct name expected; '%s' is %s", type->str, tokens[type->tok - Num]); }
+      return type;
+    }
+    type = declare(type);
   }
   if (tok ==';') { // struct declaration?
     if (!type) {
-      printf("%d: bad struct declaration; struct name expected, got ';'\n", l); exit(-1);
+      error(l, "bad struct declaration; struct name expected, got ';'");
     } else if (type->tok == Struct) {
-      printf("%d: duplicate struct declaration; struct name '%s' already declared in line %d\n", l, type->str, type->line); exit(-1);
+      error(l, "duplicate struct declaration; struct name '%s' already declared in line %d", type->str, type->line);
     } else if (type->tok != Id) {
-      printf("%d: bad struct declaration; struct name '%s' already declared in line %d as %s\n", l, type->str, type->line, tokens[id->tok - Num]); exit(-1);
+      error(l, "bad struct declaration; struct name '%s' already declared in line %d as %s", type->str, type->line, tokens[type->tok - Num]);
     }
     type->tok = Struct;
     type->val = sizeof(int);
+    type->line = l;
   } else if (tok == '{') { // struct definition?
     if (type) {
       if (type->tok == Struct) {
-        printf("%d: duplicate struct definition; struct name '%s' already declared in line %d\n", l, type->str, type->line); exit(-1);
+        error(l, "duplicate struct definition; struct name '%s' already declared in line %d", type->str, type->line);
       } else if (type->tok != Id) {
-        printf("%d: bad struct definition; struct name '%s' already declared in line %d as %s\n", l, type->str, type->line, tokens[id->tok - Num]); exit(-1);
+        error(l, "bad struct definition; struct name '%s' already declared in line %d as %s", type->str, type->line, tokens[type->tok - Num]);
       }
     } else {
       char str[32];
       sprintf(str, "__unnamed_struct_%04X", structs);
-      int h = get_hash(str);
-      type = new_id(Id, str, l, h); type->next = ids; ids = type;
+      type = declare(intern(str, strlen(str), l));
     }
     ++structs;
     type->tok = Struct;
     type->val = sizeof(int);
+    type->line = l;
     next();
     int o = 0; // offset in structure
+    Identifier** last = &type->ref; // members in order of declaration
     while (tok !='}') {
-      // TODO
+      Identifier* t = decl();
+      if (!t) { error(line, "bad struct definition; member type expected, got %s", tok_name(tok)); }
+      while (1) {
+        int ptr = 0;
+        while (tok == Mul) { next(); ++ptr; }
+        if (tok != Id) { error(line, "bad struct definition; member name expected, got %s", tok_name(tok)); }
+        if (!ptr && (t == voidid || t == type || (t->tok == Struct && !t->ref))) { error(line, "bad struct definition; member '%s' has incomplete type", id->str); }
+        for (Identifier* m = type->ref; m; m = m->next) {
+          if (m->str == id->str) { error(line, "duplicate struct member '%s'; already declared in line %d", id->str, m->line); }
+        }
+        Identifier* m = new_id(Member, id->str, id->hash, line);
+        int sz = size_of(t, ptr);
+        int align = (sz >= (int) sizeof (int) || (!ptr && t->tok == Struct)) ? sizeof (int) : 1;
+        o = (o + align - 1) & -align;
+        m->ptr = ptr; m->ref = t; m->val = o;
+        o += sz;
+        *last = m; last = &m->next; // add member to member list
+        next();
+        if (tok != ',') break;
+        next();
+      }
+      expect(';', "after struct member");
     }
-  } else { printf("%d: struct declaration or definition expected, got %s\n", l, tokens[id->tok - Num]); exit(-1); }
+    next();
+    type->val = (o + sizeof (int) - 1) & -(int) sizeof (int);
+  } else error(l, "struct declaration or definition expected, got %s", tok_name(tok));
   return type;
 }
 
-// "char" ('*')* identifier (',' ('*')* identifier)* ';' |
-// "int" ('*')* identifier (',' ('*')* identifier)* ';' |
-// "enum" identifier ';' |
-// "enum" identifier '{' (identifier ('=' number)? (',' identifier ('=' number)?)*)? '}' (('*')* identifier (',' ('*')* identifier)*)? ';' |
-// "enum" '{' (identifier ('=' number)? (',' identifier ('=' number)?)*)? '}' ('*')* identifier (',' ('*')* identifier)* ';' |
-// "struct" identifier ';' |
-// "struct" identifier '{' (type ('*')* identifier ';')* '}' (('*')* identifier (',' ('*')* identifier)*)? ';' |
-// "struct" '{' (type ('*')* identifier ';')* '}' ('*')* identifier (',' ('*')* identifier)* ';' |
-// type ('*')* identifier (',' ('*')* identifier)* ';'
+// type of a declaration: "char", "int", "void", enum or struct declaration or definition, or enum or struct name;
+// 0 if the current token does not start a declaration
 static Identifier* decl() {
   Identifier* type = 0;
   switch (tok) {
   case CharKW:
-    type = id;
-    break;
   case IntKW:
+  case VoidKW:
     type = id;
+    next();
     break;
   case EnumKW:
     type = enum_decl();
@@ -180,59 +605,1083 @@ static Identifier* decl() {
   case Id: // Identifier
     type = id;
     if (type->tok != Enum && type->tok != Struct) return 0; // not a type
+    next();
     break;
   default:
     return 0; // not a declaration
   }
+  return type;
+}
+
+// type of a cast or sizeof: type ('*')*
+static int type_name(Identifier** type) {
   int ptr = 0;
-  while (tok == '*') {
+  *type = decl();
+  while (tok == Mul) { next(); ++ptr; }
+  return ptr;
+}
+
+static int is_type() {
+  return tok == CharKW || tok == IntKW || tok == VoidKW || tok == EnumKW || tok == StructKW ||
+         (tok == Id && (id->tok == Enum || id->tok == Struct));
+}
+
+static int num(int v) {
+  return node(Num, v, 0, 0, intid, 0);
+}
+
+// operand of an operation: a char, int, enum or pointer value
+static int rval(int n) {
+  if (!nptr[n] && (ntype[n] == voidid || ntype[n]->tok == Struct)) {
+    error(nline[n], "bad operand; value of type '%s' not allowed here", ntype[n]->str);
+  }
+  return n;
+}
+
+// size of the value a pointer points to; void* counts bytes
+static int elem_size(int n) {
+  return (nptr[n] == 1 && ntype[n] == voidid) ? 1 : size_of(ntype[n], nptr[n] - 1);
+}
+
+static int cast(int n, Identifier* type, int ptr) {
+  if (ntype[n] == type && nptr[n] == ptr) return n;
+  if (kind(n) == Num) { // constant: truncate to char or just take the new type
+    if (!ptr && type == charid) na[n] = (char) na[n];
+    ntype[n] = type; nptr[n] = ptr;
+    return n;
+  }
+  return node(Cast, n, 0, 0, type, ptr);
+}
+
+static int binary(int op, int a, int b) {
+  int v;
+  if (kind(a) == Num && kind(b) == Num && ((op != Div && op != Mod) || na[b])) { // fold constants
+    int x = na[a], y = na[b];
+    switch (op) {
+    case Or: v = x | y; break;
+    case Xor: v = x ^ y; break;
+    case And: v = x & y; break;
+    case Eq: v = x == y; break;
+    case Ne: v = x != y; break;
+    case Lt: v = x < y; break;
+    case Gt: v = x > y; break;
+    case Le: v = x <= y; break;
+    case Ge: v = x >= y; break;
+    case Shl: v = (unsigned) x << y; break;
+    case Shr: v = x >> y; break;
+    case Add: v = (unsigned) x + y; break;
+    case Sub: v = (unsigned) x - y; break;
+    case Mul: v = (unsigned) x * y; break;
+    case Div: v = x / y; break;
+    case Mod: v = x % y; break;
+    default: v = 0;
+    }
+    return num(v);
+  }
+  return node(op, a, b, 0, intid, 0);
+}
+
+static int expr(int lev) {
+  int n, a, t, ptr;
+  Identifier* i;
+
+  if (tok == Num) { n = num(val); next(); }
+  else if (tok == Str) { n = node(Str, val, 0, 0, charid, 1); next(); }
+  else if (tok == SizeofKW) {
     next();
-    ++ptr;
+    expect('(', "after 'sizeof'");
+    if (is_type()) ptr = type_name(&i);
+    else { n = expr(Assign); i = ntype[n]; ptr = nptr[n]; }
+    expect(')', "after sizeof");
+    if (!ptr && (i == voidid || (i->tok == Struct && !i->ref))) { error(line, "bad sizeof; incomplete type '%s'", i->str); }
+    n = num(size_of(i, ptr));
   }
-  return type;
+  else if (tok == Id) {
+    i = id; next();
+    if (tok == '(') { // function call
+      if (i->tok != Func && i->tok != Sys) { error(line, "bad function call; '%s' is %s", i->str, tokens[i->tok - Num]); }
+      next();
+      int first = 0, last = 0, k = 0;
+      while (tok != ')') {
+        a = rval(expr(Assign));
+        if (last) nnext[last] = a; else first = a;
+        last = a; ++k;
+        if (tok == ',') next();
+        else if (tok != ')') { error(line, "bad function call; ',' or ')' expected, got %s", tok_name(tok)); }
+      }
+      next();
+      if (i->tok == Sys) {
+        const Library* l = &library[i->val];
+        if (k < l->params || (k > l->params && !l->variadic)) { error(line, "bad function call; '%s' takes %s%d arguments, got %d", i->str, l->variadic ? "at least " : "", l->params, k); }
+        n = node(Sys, i->val, first, 0, i->ref, i->ptr);
+      }
+      else {
+        if (k != funcs[i->val].params) { error(line, "bad function call; '%s' takes %d arguments, got %d", i->str, funcs[i->val].params, k); }
+        n = node(Func, i->val, first, 0, i->ref, i->ptr);
+      }
+    }
+    else if (i->tok == Num) n = num(i->val); // enumerator
+    else if (i->tok == Local || i->tok == Global) n = node(Load, node(i->tok, i->val, 0, 0, i->ref, i->ptr + 1), 0, 0, i->ref, i->ptr);
+    else if (i->tok == Id) error(line, "undeclared identifier '%s'", i->str);
+    else { error(line, "bad expression; '%s' is %s", i->str, tokens[i->tok - Num]); }
+  }
+  else if (tok == '(') {
+    next();
+    if (is_type()) {
+      ptr = type_name(&i);
+      expect(')', "after cast type");
+      n = rval(expr(Inc));
+      if (!ptr && i->tok == Struct) error(line, "bad cast to struct '%s'", i->str);
+      n = cast(n, i, ptr);
+    }
+    else {
+      n = expr(Assign);
+      expect(')', "in expression");
+    }
+  }
+  else if (tok == Mul) {
+    next();
+    n = rval(expr(Inc));
+    if (!nptr[n] || (nptr[n] == 1 && ntype[n] == voidid)) error(line, "bad dereference");
+    n = node(Load, n, 0, 0, ntype[n], nptr[n] - 1);
+  }
+  else if (tok == And) {
+    next();
+    n = expr(Inc);
+    if (kind(n) != Load) error(line, "bad address-of");
+    n = na[n]; // address, already typed as pointer
+  }
+  else if (tok == '!') { next(); n = binary(Eq, rval(expr(Inc)), num(0)); }
+  else if (tok == '~') { next(); n = binary(Xor, rval(expr(Inc)), num(-1)); }
+  else if (tok == Add) { next(); n = rval(expr(Inc)); }
+  else if (tok == Sub) { next(); n = binary(Sub, num(0), rval(expr(Inc))); }
+  else if (tok == Inc || tok == Dec) {
+    t = tok; next();
+    n = expr(Inc);
+    if (kind(n) != Load) error(line, "bad lvalue in pre-%s", t == Inc ? "increment" : "decrement");
+    rval(n);
+    n = node(t, na[n], nptr[n] ? elem_size(n) : 1, 0, ntype[n], nptr[n]);
+  }
+  else { error(line, "bad expression; got %s", tok_name(tok)); }
+
+  while (tok >= lev) { // "precedence climbing" or "Top Down Operator Precedence" method
+    t = tok;
+    if (t == Assign) {
+      next();
+      if (kind(n) != Load) error(line, "bad lvalue in assignment");
+      rval(n);
+      a = rval(expr(Assign));
+      n = node(Assign, na[n], a, 0, ntype[n], nptr[n]);
+    }
+    else if (t == Cond) {
+      next();
+      a = expr(Assign);
+      expect(':', "in conditional expression");
+      int b = expr(Cond);
+      n = node(Cond, rval(n), rval(a), rval(b), ntype[a], nptr[a]);
+    }
+    else if (t == Lor || t == Land) {
+      next();
+      a = rval(expr(t == Lor ? Land : Or));
+      rval(n);
+      if (kind(n) == Num && kind(a) == Num) n = num(t == Lor ? (na[n] || na[a]) : (na[n] && na[a]));
+      else n = node(t, n, a, 0, intid, 0);
+    }
+    else if (t >= Or && t <= Mod) { // right operand binds one precedence level tighter
+      next();
+      a = rval(expr((t < Eq) ? t + 1 : (t < Lt) ? Lt : (t < Shl) ? Shl : (t < Add) ? Add : (t < Mul) ? Mul : Inc));
+      rval(n);
+      if (t == Add) {
+        if (nptr[a]) error(line, "bad pointer addition");
+        if (nptr[n]) {
+          Identifier* type = ntype[n]; ptr = nptr[n];
+          n = node(Add, n, binary(Mul, a, num(elem_size(n))), 0, type, ptr);
+        }
+        else n = binary(Add, n, a);
+      }
+      else if (t == Sub) {
+        if (!nptr[n] && nptr[a]) error(line, "bad pointer subtraction");
+        if (nptr[n] && nptr[a]) {
+          if (ntype[n] != ntype[a] || nptr[n] != nptr[a]) error(line, "bad pointer types in subtraction");
+          n = binary(Div, node(Sub, n, a, 0, intid, 0), num(elem_size(n)));
+        }
+        else if (nptr[n]) {
+          Identifier* type = ntype[n]; ptr = nptr[n];
+          n = node(Sub, n, binary(Mul, a, num(elem_size(n))), 0, type, ptr);
+        }
+        else n = binary(Sub, n, a);
+      }
+      else {
+        if ((nptr[n] || nptr[a]) && (t < Eq || t > Ge)) error(line, "bad pointer arithmetic");
+        n = binary(t, n, a);
+      }
+    }
+    else if (t == Inc || t == Dec) { // post-increment: increment, then undo on the value
+      if (kind(n) != Load) error(line, "bad lvalue in post-%s", t == Inc ? "increment" : "decrement");
+      rval(n);
+      int step = nptr[n] ? elem_size(n) : 1;
+      Identifier* type = ntype[n]; ptr = nptr[n];
+      n = node(t == Inc ? Sub : Add, node(t, na[n], step, 0, type, ptr), num(step), 0, type, ptr);
+      next();
+    }
+    else if (t == Bracket) {
+      next();
+      if (!nptr[n] || (nptr[n] == 1 && ntype[n] == voidid)) error(line, "pointer type expected");
+      a = rval(expr(Assign));
+      if (nptr[a]) error(line, "bad array index");
+      expect(']', "after array index");
+      n = node(Load, node(Add, n, binary(Mul, a, num(elem_size(n))), 0, ntype[n], nptr[n]), 0, 0, ntype[n], nptr[n] - 1);
+    }
+    else if (t == Dot || t == Arrow) {
+      next();
+      if (t == Dot) { // struct value: use its address
+        if (kind(n) != Load || nptr[n] || ntype[n]->tok != Struct) { error(line, "bad member access; struct expected"); }
+        n = na[n];
+      }
+      else if (nptr[n] != 1 || ntype[n]->tok != Struct) { error(line, "bad member access; struct pointer expected"); }
+      if (tok != Id) { error(line, "bad member access; member name expected, got %s", tok_name(tok)); }
+      Identifier* m = ntype[n]->ref;
+      while (m && m->str != id->str) m = m->next;
+      if (!m) { error(line, "bad member access; '%s' is no member of '%s'", id->str, ntype[n]->str); }
+      next();
+      n = node(Load, node(Add, n, num(m->val), 0, m->ref, m->ptr + 1), 0, 0, m->ref, m->ptr);
+    }
+    else error(line, "compiler error (tok=%d)", tok);
+  }
+  return n;
+}
+
+static int block();
+
+static int stmt() {
+  int n, a, b, c;
+  if (tok == IfKW) {
+    next();
+    expect('(', "after 'if'");
+    a = rval(expr(Assign));
+    expect(')', "after if condition");
+    b = stmt();
+    c = 0;
+    if (tok == ElseKW) { next(); c = stmt(); }
+    return node(IfKW, a, b, c, voidid, 0);
+  }
+  else if (tok == WhileKW) {
+    next();
+    expect('(', "after 'while'");
+    a = rval(expr(Assign));
+    expect(')', "after while condition");
+    return node(WhileKW, a, stmt(), 0, voidid, 0);
+  }
+  else if (tok == ReturnKW) {
+    Identifier* f = funcs[fn].id;
+    next();
+    a = 0;
+    if (tok != ';') {
+      if (!f->ptr && f->ref == voidid) { error(line, "bad return; '%s' returns void", f->str); }
+      a = cast(rval(expr(Assign)), f->ref, f->ptr);
+    }
+    expect(';', "after return");
+    return node(ReturnKW, a, 0, 0, voidid, 0);
+  }
+  else if (tok == '{') return block();
+  else if (tok == ';') { next(); return node(Block, 0, 0, 0, voidid, 0); }
+  n = expr(Assign);
+  expect(';', "after expression");
+  return n;
+}
+
+// ('auto')? type ('*')* identifier (',' ('*')* identifier)* ';'
+static void local_decl(Identifier* type) {
+  while (tok != ';') {
+    int ptr = 0;
+    while (tok == Mul) { next(); ++ptr; }
+    if (tok != Id) { error(line, "bad local declaration; identifier expected, got %s", tok_name(tok)); }
+    Identifier* i = declare(id);
+    if (i->tok != Id) { error(line, "duplicate local definition; '%s' already declared in line %d as %s", i->str, i->line, tokens[i->tok - Num]); }
+    if (!ptr && (type == voidid || (type->tok == Struct && !type->ref))) { error(line, "bad local declaration; '%s' has incomplete type", i->str); }
+    locals -= (size_of(type, ptr) + sizeof (int) - 1) / sizeof (int);
+    i->tok = Local; i->ptr = ptr; i->ref = type; i->val = locals; i->line = line;
+    next();
+    if (tok == ',') next();
+    else if (tok != ';') { error(line, "bad local declaration; ',' or ';' expected, got %s", tok_name(tok)); }
+  }
+  next();
+}
+
+// '{' (declaration)* (statement)* '}'
+static int block() {
+  int first = 0, last = 0, n;
+  int l = line;
+  next();
+  enter_scope();
+  while (1) {
+    if (tok == AutoKW) next();
+    Identifier* type = decl();
+    if (!type) break;
+    local_decl(type);
+  }
+  while (tok != '}') {
+    if (!tok) error(line, "'}' expected for block in line %d, got end of file", l);
+    n = stmt();
+    if (last) nnext[last] = n; else first = n;
+    last = n;
+  }
+  next();
+  leave_scope();
+  return node(Block, first, 0, 0, voidid, 0);
+}
+
+// (type ('*')* identifier (',' type ('*')* identifier)*)? ')'; returns the number of parameters
+static int params() {
+  int n = 0;
+  while (tok != ')') {
+    Identifier* t = decl();
+    if (!t) { error(line, "bad parameter declaration; type expected, got %s", tok_name(tok)); }
+    int p = 0;
+    while (tok == Mul) { next(); ++p; }
+    if (t == voidid && !p && !n && tok == ')') break; // (void)
+    if (tok != Id) { error(line, "bad parameter declaration; identifier expected, got %s", tok_name(tok)); }
+    Identifier* a = declare(id);
+    if (a->tok != Id) error(line, "duplicate parameter definition '%s'", a->str);
+    if (!p && (t == voidid || t->tok == Struct)) { error(line, "bad parameter declaration; '%s' must be char, int, enum or pointer", a->str); }
+    a->tok = Local; a->ptr = p; a->ref = t; a->val = 2 + n++; a->line = line;
+    next();
+    if (tok == ',') next();
+    else if (tok != ')') { error(line, "bad parameter declaration; ',' or ')' expected, got %s", tok_name(tok)); }
+  }
+  next();
+  return n;
+}
+
+// skip the block of a function body in the first pass; only braces, literals and comments matter
+static void skip_body() {
+  int l = line, depth = 1;
+  while (depth) {
+    if (!*p) error(line, "'}' expected for block in line %d, got end of file", l);
+    int c = *p++;
+    if (c == '\n') ++line;
+    else if (c == '{') ++depth;
+    else if (c == '}') --depth;
+    else if (c == '\'' || c == '"') {
+      while (*p && *p != c && *p != '\n') { if (*p++ == '\\' && *p) ++p; }
+      if (*p != c) error(line, "unterminated %s literal", c == '"' ? "string" : "character");
+      ++p;
+    }
+    else if (c == '/' && *p == '/') { while (*p && *p != '\n') ++p; }
+    else if (c == '/' && *p == '*') {
+      ++p;
+      while (*p && (*p != '*' || p[1] != '/')) { if (*p++ == '\n') ++line; }
+      if (*p) p += 2;
+    }
+  }
+  --braces;
+  next();
+}
+
+// type ('*')* identifier '(' parameters (';' | block); the body is only skipped, see func_body();
+// returns 1 for a definition
+static int func_decl(Identifier* f, Identifier* type, int ptr) {
+  int l = line;
+  int declared = f->tok == Func;
+  if (f->tok == Id) {
+    if (nfuncs == maxfuncs) funcs = (Function*) grow(funcs, &maxfuncs, sizeof (Function), "function table");
+    f->tok = Func; f->ptr = ptr; f->ref = type; f->val = nfuncs; f->line = l;
+    memset(&funcs[nfuncs], 0, sizeof (Function));
+    funcs[nfuncs++].id = f;
+  }
+  else if (f->tok != Func || f->ref != type || f->ptr != ptr) {
+    error(l, "bad function declaration; '%s' already declared in line %d as %s", f->str, f->line, tokens[f->tok - Num]);
+  }
+  fn = f->val;
+  const char* s = p; // behind '('
+  next();
+  enter_scope();
+  int n = params();
+  leave_scope();
+  if (declared && funcs[fn].params != n) { error(l, "bad function declaration; '%s' declared in line %d with %d parameters", f->str, f->line, funcs[fn].params); }
+  funcs[fn].params = n;
+  if (tok != '{') return 0;
+  if (funcs[fn].src) { error(l, "duplicate function definition; '%s' already defined", f->str); }
+  skip_body();
+  funcs[fn].src = s; funcs[fn].line = l;
+  return 1;
+}
+
+// parse parameters and body of function f again, in a worker
+static void func_body(int f) {
+  fn = f;
+  p = funcs[f].src; line = funcs[f].line;
+  next();
+  enter_scope();
+  params();
+  locals = 0;
+  funcs[f].body = block();
+  funcs[f].frame = -locals;
+  leave_scope();
+}
+
+// "char" ('*')* identifier (',' ('*')* identifier)* ';' |
+// "int" ('*')* identifier (',' ('*')* identifier)* ';' |
+// "enum" identifier ';' |
+// "enum" identifier '{' (identifier ('=' number)? (',' identifier ('=' number)?)*)? '}' (('*')* identifier (',' ('*')* identifier)*)? ';' |
+// "enum" '{' (identifier ('=' number)? (',' identifier ('=' number)?)*)? '}' ('*')* identifier (',' ('*')* identifier)* ';' |
+// "struct" identifier ';' |
+// "struct" identifier '{' (type ('*')* identifier ';')* '}' (('*')* identifier (',' ('*')* identifier)*)? ';' |
+// "struct" '{' (type ('*')* identifier ';')* '}' ('*')* identifier (',' ('*')* identifier)* ';' |
+// type ('*')* identifier (',' ('*')* identifier)* ';' |
+// type ('*')* identifier '(' parameters ')' (';' | block)
+static void global_decl() {
+  Identifier* type = decl();
+  if (!type) error(line, "declaration expected, got %s", tok_name(tok));
+  while (tok != ';') {
+    int ptr = 0;
+    while (tok == Mul) { next(); ++ptr; }
+    if (tok != Id) { error(line, "bad global declaration; identifier expected, got %s", tok_name(tok)); }
+    Identifier* i = id;
+    next();
+    if (tok == '(') {
+      if (func_decl(i, type, ptr)) return; // function definition ends the declaration
+    }
+    else {
+      if (i->tok != Id) { error(line, "duplicate global definition; '%s' already declared in line %d as %s", i->str, i->line, tokens[i->tok - Num]); }
+      if (!ptr && (type == voidid || (type->tok == Struct && !type->ref))) { error(line, "bad global declaration; '%s' has incomplete type", i->str); }
+      i->tok = Global; i->ptr = ptr; i->ref = type; i->line = line;
+      i->val = data_alloc(size_of(type, ptr));
+    }
+    if (tok == ',') next();
+    else if (tok != ';') { error(line, "bad global declaration; ',' or ';' expected, got %s", tok_name(tok)); }
+  }
+  next();
+}
+
+// skip the rest of a declaration in error: behind a ';' outside of braces or the '}' closing them
+static void skip_decl() {
+  while (tok) {
+    if (tok == ';' && !braces) { next(); return; }
+    if (tok == '}' && !braces) {
+      next();
+      if (tok == ';') next();
+      return;
+    }
+    next();
+  }
+}
+
+// (declaration)*; first pass, function bodies are skipped; resumes behind a declaration in error
+static void module() {
+  jmp_buf env;
+  jmp_buf* outer = recover;
+  recover = &env;
+  line = 1; braces = 0;
+  if (setjmp(env)) { while (scope) leave_scope(); skip_decl(); }
+  else next();
+  while (tok) global_decl();
+  recover = outer;
+}
+
+// typed IR of one function: instructions are indices into parallel arrays, each defined once
+// and named by its index ("SSA-lite": variables stay in memory, values meet only in IPhi)
+enum IrOp {
+  IConst,  // a: value
+  IData,   // a: data segment offset; address
+  IStr,    // a: offset in the string literals of the thread; address
+  ILocal,  // a: frame offset; address
+  ILoad,   // a: address
+  IStore,  // a: address, b: value; result is the stored value
+  IBin,    // a, b: operands, c: operator token Or...Mod
+  ITrunc,  // a: value truncated to char
+  IArg,    // a: argument value, passed last to first
+  ICall,   // a: function index, b: number of arguments
+  ISys,    // a: library index, b: number of arguments
+  ILabel,  // a: label
+  IJmp,    // a: label
+  IBz,     // a: condition, b: label
+  IBnz,    // a: condition, b: label
+  IPhi,    // a, b: values reaching the preceding label from its two predecessors
+  IRet     // a: value or 0
+};
+
+enum IrType { IVoid, I8, I32, IPtr };
+
+thread_local int ninstrs;          // number of instructions; 0 stands for no value
+thread_local int maxinstrs;        // capacity of the instruction arrays
+thread_local unsigned char* iop;   // operation, see enum IrOp
+thread_local unsigned char* ity;   // type of the value, see enum IrType
+thread_local unsigned char* ipush; // the value is used from the VM stack
+thread_local int* ia;              // first operand
+thread_local int* ib;              // second operand
+thread_local int* ic;              // third operand
+thread_local int nlabels;          // number of labels of the function
+
+static int ir(int op, int type, int a, int b, int c) {
+  if (ninstrs == maxinstrs) {
+    int m = maxinstrs;
+    iop = (unsigned char*) grow(iop, &m, sizeof (unsigned char), "IR"); m = maxinstrs;
+    ity = (unsigned char*) grow(ity, &m, sizeof (unsigned char), "IR"); m = maxinstrs;
+    ipush = (unsigned char*) grow(ipush, &m, sizeof (unsigned char), "IR"); m = maxinstrs;
+    ia = (int*) grow(ia, &m, sizeof (int), "IR"); m = maxinstrs;
+    ib = (int*) grow(ib, &m, sizeof (int), "IR"); m = maxinstrs;
+    ic = (int*) grow(ic, &m, sizeof (int), "IR");
+    maxinstrs = m;
+  }
+  iop[ninstrs] = op; ity[ninstrs] = type; ipush[ninstrs] = 0;
+  ia[ninstrs] = a; ib[ninstrs] = b; ic[ninstrs] = c;
+  return ninstrs++;
 }
 
-static int module() {
+static int ir_type(int n) {
+  if (nptr[n]) return IPtr;
+  if (ntype[n] == charid) return I8;
+  if (ntype[n] == voidid) return IVoid;
+  return I32;
 }
 
-static int compile() {
+static int lower(int n);
+
+// jump to label l if the truth value of n is sense; && and || short-circuit
+static void branch(int n, int l, int sense) {
+  int k = kind(n);
+  if (k == Lor || k == Land) {
+    if ((k == Lor) == sense) { branch(na[n], l, sense); branch(nb[n], l, sense); return; }
+    int skip = nlabels++;
+    branch(na[n], skip, !sense);
+    branch(nb[n], l, sense);
+    ir(ILabel, IVoid, skip, 0, 0);
+  }
+  else if (k == Eq && kind(nb[n]) == Num && !na[nb[n]]) branch(na[n], l, !sense); // !x
+  else ir(sense ? IBnz : IBz, IVoid, lower(n), l, 0);
+}
+
+// arguments are passed last to first
+static int lower_args(int n) {
+  if (!n) return 0;
+  int k = lower_args(nnext[n]);
+  ir(IArg, IVoid, lower(n), 0, 0);
+  return k + 1;
+}
+
+static int lower(int n) {
+  int k = kind(n), a, b, l, e;
+  switch (k) {
+  case Num: return ir(IConst, I32, na[n], 0, 0);
+  case Str: return ir(IStr, IPtr, na[n], 0, 0);
+  case Global: return ir(IData, IPtr, na[n], 0, 0);
+  case Local: return ir(ILocal, IPtr, na[n], 0, 0);
+  case Load: a = lower(na[n]); return ir(ILoad, ir_type(n), a, 0, 0);
+  case Assign: a = lower(na[n]); b = lower(nb[n]); return ir(IStore, ir_type(n), a, b, 0);
+  case Inc:
+  case Dec:
+    a = lower(na[n]);
+    b = ir(ILoad, ir_type(n), a, 0, 0);
+    b = ir(IBin, ir_type(n), b, ir(IConst, I32, nb[n], 0, 0), k == Inc ? Add : Sub);
+    return ir(IStore, ir_type(n), a, b, 0);
+  case Cast:
+    a = lower(na[n]);
+    if (ir_type(n) == I8 && ir_type(na[n]) != I8) a = ir(ITrunc, I8, a, 0, 0);
+    return a;
+  case Cond:
+    l = nlabels++; e = nlabels++;
+    branch(na[n], l, 0);
+    a = lower(nb[n]);
+    ir(IJmp, IVoid, e, 0, 0);
+    ir(ILabel, IVoid, l, 0, 0);
+    b = lower(nc[n]);
+    ir(ILabel, IVoid, e, 0, 0);
+    return ir(IPhi, ir_type(n), a, b, 0);
+  case Lor:
+  case Land: // 0 or 1
+    l = nlabels++; e = nlabels++;
+    branch(n, l, 1);
+    a = ir(IConst, I32, 0, 0, 0);
+    ir(IJmp, IVoid, e, 0, 0);
+    ir(ILabel, IVoid, l, 0, 0);
+    b = ir(IConst, I32, 1, 0, 0);
+    ir(ILabel, IVoid, e, 0, 0);
+    return ir(IPhi, I32, a, b, 0);
+  case Func:
+  case Sys:
+    a = lower_args(nb[n]);
+    return ir(k == Func ? ICall : ISys, ir_type(n), na[n], a, 0);
+  default:
+    if (k >= Or && k <= Mod) { a = lower(na[n]); b = lower(nb[n]); return ir(IBin, ir_type(n), a, b, k); }
+  }
+  error(nline[n], "compiler error (node kind=%d)", k);
+}
+
+static void lower_stmt(int n) {
+  int k = kind(n), l, e;
+  if (k == Block) { for (n = na[n]; n; n = nnext[n]) lower_stmt(n); }
+  else if (k == IfKW) {
+    l = nlabels++;
+    branch(na[n], l, 0);
+    lower_stmt(nb[n]);
+    if (nc[n]) {
+      e = nlabels++;
+      ir(IJmp, IVoid, e, 0, 0);
+      ir(ILabel, IVoid, l, 0, 0);
+      lower_stmt(nc[n]);
+      l = e;
+    }
+    ir(ILabel, IVoid, l, 0, 0);
+  }
+  else if (k == WhileKW) { // condition at the bottom
+    l = nlabels++; e = nlabels++;
+    ir(IJmp, IVoid, e, 0, 0);
+    ir(ILabel, IVoid, l, 0, 0);
+    lower_stmt(nb[n]);
+    ir(ILabel, IVoid, e, 0, 0);
+    branch(na[n], l, 1);
+  }
+  else if (k == ReturnKW) ir(IRet, IVoid, na[n] ? lower(na[n]) : 0, 0, 0);
+  else lower(n);
+}
+
+// lower function f to IR; values used by a later instruction other than the next one go on the VM stack
+static void lower_func(int f) {
+  ninstrs = 0; nlabels = 0;
+  ir(IRet, IVoid, 0, 0, 0); // instruction 0: no value
+  lower_stmt(funcs[f].body);
+  ir(IRet, IVoid, 0, 0, 0);
+  for (int i = 1; i < ninstrs; ++i) {
+    if (iop[i] == IBin || iop[i] == IStore) ipush[ia[i]] = 1;
+  }
+}
+
+// VM code: words of opcodes and parameters; jump targets are code indices;
+// workers emit into their own code, merge() puts it together in the code of the main thread
+thread_local int* code;        // code of the thread's functions
+thread_local int ncode;        // number of code words
+thread_local int maxcode;      // capacity of code
+thread_local int* laddr;       // code index of each label, or the last unresolved use (chained through the uses) as -2 - index
+thread_local int maxlabels;    // capacity of laddr
+thread_local int* relocs;      // code indices of string literal addresses, relative to strs
+thread_local int nrelocs;      // number of entries in relocs
+thread_local int maxrelocs;    // capacity of relocs
+int stub;                      // code index of the exit call main returns to
+
+enum { DataBase = 16 }; // VM address of the data segment; below is an unmapped guard for null pointers
+
+static void emit(int w) {
+  if (ncode == maxcode) code = (int*) grow(code, &maxcode, sizeof (int), "code area");
+  code[ncode++] = w;
+}
+
+static void emit_label_use(int l) {
+  emit(laddr[l]); // previous use or resolved address
+  if (laddr[l] < 0) laddr[l] = -2 - (ncode - 1);
+}
+
+// emit VM code for the IR of function f; calls are patched by link()
+static void gen_func(int f) {
+  int last = 0; // value in the accumulator
+  while (maxlabels < nlabels) laddr = (int*) grow(laddr, &maxlabels, sizeof (int), "label table");
+  for (int l = 0; l < nlabels; ++l) laddr[l] = -1;
+  funcs[f].code = ncode;
+  funcs[f].reloc = nrelocs;
+  emit(ENTER); emit(funcs[f].frame);
+  for (int i = 1; i < ninstrs; ++i) {
+    int op = iop[i], a = ia[i];
+    // operands other than pushed ones are taken from the accumulator
+    if ((op == ILoad || op == ITrunc || op == IArg || op == IBz || op == IBnz || (op == IRet && a)) && a != last) {
+      error(0, "compiler error: operand %d of instruction %d not in accumulator", a, i);
+    }
+    switch (op) {
+    case IConst: emit(IMM); emit(a); break;
+    case IData: emit(IMM); emit(DataBase + a); break;
+    case IStr:
+      emit(IMM); emit(DataBase + a);
+      if (nrelocs == maxrelocs) relocs = (int*) grow(relocs, &maxrelocs, sizeof (int), "relocations");
+      relocs[nrelocs++] = ncode - 1;
+      break;
+    case ILocal: emit(LEA); emit(a); break;
+    case ILoad: emit(ity[i] == I8 ? LC : LI); break;
+    case IStore: emit(ity[i] == I8 ? SC : SI); break;
+    case IBin: emit(OR + ic[i] - Or); break;
+    case ITrunc: emit(PUSH); emit(IMM); emit(24); emit(SHL); emit(PUSH); emit(IMM); emit(24); emit(SHR); break;
+    case IArg: emit(PUSH); break;
+    case ICall: emit(JSR); emit(a); if (ib[i]) { emit(ADJ); emit(ib[i]); } break;
+    case ISys: emit(library[a].op); if (ib[i]) { emit(ADJ); emit(ib[i]); } break;
+    case ILabel: { // resolve the chain of uses
+      int u = laddr[a];
+      while (u < -1) { int p = -2 - u; u = code[p]; code[p] = ncode; }
+      laddr[a] = ncode;
+      break;
+    }
+    case IJmp: emit(JMP); emit_label_use(a); break;
+    case IBz: emit(BZ); emit_label_use(ib[i]); break;
+    case IBnz: emit(BNZ); emit_label_use(ib[i]); break;
+    case IPhi: break;
+    case IRet: emit(LEAVE); break;
+    }
+    last = (ity[i] != IVoid || op == IPhi || op == ICall || op == ISys) ? i : 0;
+    if (ipush[i]) emit(PUSH);
+  }
+  funcs[f].end = ncode;
+  funcs[f].nrelocs = nrelocs - funcs[f].reloc;
+}
+
+// replace function indices in JSR by code addresses; each undefined function is reported once.
+// the code is walked function by function, in step with the instructions
+static int link() {
+  int ret = 0;
+  for (int g = 0; g < nfuncs; ++g) {
+    if (!funcs[g].src) continue;
+    for (int i = funcs[g].code; i < funcs[g].end; i += (code[i] <= ADJ) ? 2 : 1) {
+      if (code[i] == JSR) {
+        Function* f = &funcs[code[i + 1]];
+        if (!f->src) {
+          if (f->code != -1) report(0, "function '%s' declared in line %d not defined", f->id->str, f->id->line);
+          f->code = -1; ret = -1;
+        }
+        code[i + 1] = f->code;
+      }
+    }
+  }
+  return ret;
+}
+
+static void print_code(int f) {
+  int i = funcs[f].code;
+  printf("%s:\n", funcs[f].id->str);
+  while (i < funcs[f].end) {
+    printf("%6d %8.4s", i, &ops[code[i] * 8]);
+    if (code[i] <= ADJ) printf(" %d\n", code[++i]); else printf("\n");
+    ++i;
+  }
+}
+
+// workers compile function bodies in parallel, each into its own AST, IR, code and string literals
+enum { MaxJobs = 64 };
+
+struct Worker {
+  int* code;    // code of the worker's functions
+  char* strs;   // string literals
+  int nstrs;    // size of strs in bytes
+  int* relocs;  // code indices of string literal addresses
+  int base;     // data segment offset of strs when merged
+};
+
+Worker workers[MaxJobs];
+std::atomic<int> todo;   // index of the next function to compile
+
+// free the identifiers, scopes, AST and IR of the thread
+static void free_thread() {
+  while (chunks) {
+    Chunk* b = chunks; chunks = b->next;
+    free(b);
+  }
+  arena = arena_end = 0;
+  free(decls); decls = 0;
+  ndecls = maxdecls = scope = 0;
+  id = 0;
+  free(nkind); free(na); free(nb); free(nc); free(nnext); free(nptr); free(ntype); free(nline);
+  nkind = 0; na = nb = nc = nnext = nptr = nline = 0; ntype = 0;
+  nodes = maxnodes = 0;
+  free(iop); free(ity); free(ipush); free(ia); free(ib); free(ic);
+  iop = ity = ipush = 0; ia = ib = ic = 0;
+  ninstrs = maxinstrs = 0;
+  free(laddr); laddr = 0;
+  maxlabels = 0;
+}
+
+// take functions until none are left; the code and string literals stay for merge().
+// a function in error is dropped
+static void work(int w) {
+  jmp_buf env;
+  int f;
+  recover = &env;
+  ltable = (Identifier**) calloc(HashSz, sizeof (Identifier*));
+  if (!ltable) report(0, "FATAL: could not calloc(%d) symbol table", HashSz * sizeof (Identifier*));
+  while (ltable && (f = todo++) < nfuncs) {
+    if (!funcs[f].src) continue;
+    if (setjmp(env)) { while (scope) leave_scope(); continue; }
+    funcs[f].worker = w;
+    nodes = 0; // the AST of the previous function is done with
+    node(Block, 0, 0, 0, voidid, 0); // node 0: no node
+    func_body(f);
+    lower_func(f);
+    gen_func(f);
+  }
+  recover = 0;
+  workers[w].code = code; workers[w].strs = strs; workers[w].nstrs = nstrs; workers[w].relocs = relocs;
+  free_thread();
+  free(ltable); ltable = 0;
+}
+
+// append the string literals of the workers to the data segment and their code in function order,
+// relocating jump targets and string literal addresses
+static void merge() {
+  for (int w = 0; w < jobs; ++w) {
+    Worker* k = &workers[w];
+    if (!k->nstrs) continue;
+    k->base = data_alloc(k->nstrs);
+    memcpy(data + k->base, k->strs, k->nstrs);
+  }
+  emit(0); // no code at index 0
+  for (int f = 0; f < nfuncs; ++f) {
+    Function* fu = &funcs[f];
+    if (!fu->src) continue;
+    Worker* k = &workers[fu->worker];
+    int d = ncode - fu->code, n = fu->end - fu->code;
+    while (maxcode < ncode + n) code = (int*) grow(code, &maxcode, sizeof (int), "code area");
+    memcpy(code + ncode, k->code + fu->code, n * sizeof (int));
+    for (int i = ncode; i < ncode + n; i += (code[i] <= ADJ) ? 2 : 1) {
+      if (code[i] == JMP || code[i] == BZ || code[i] == BNZ) code[i + 1] += d;
+    }
+    ncode += n;
+    for (int r = fu->reloc; r < fu->reloc + fu->nrelocs; ++r) code[k->relocs[r] + d] += k->base;
+    fu->code += d; fu->end += d;
+  }
+}
+
+// first pass over the declarations, then the function bodies by the workers;
+// all errors are reported, any of them fails the compilation
+int cc_compile(const char* file) {
+  std::thread threads[MaxJobs];
+  jmp_buf env;
+  FILE* f = fopen(file, "rb");
+  if (!f) { report(0, "FATAL: could not open(%s)", file); return -1; }
+  fseek(f, 0, SEEK_END);
+  int sz = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char* volatile text = (char*) malloc(sz + 1); // freed after an error
+  if (!text) { fclose(f); report(0, "FATAL: could not malloc(%d) source area", sz + 1); return -1; }
+  sz = fread(text, 1, sz, f);
+  fclose(f);
+  text[sz] = 0;
+  recover = &env;
+  if (setjmp(env)) { recover = 0; p = 0; free(text); return -1; }
+  p = text;
+  module();
+  p = 0;
+  Identifier* m = intern("main", 4, 0);
+  if (m->tok != Func || !funcs[m->val].src) report(0, "main() not defined");
+  todo = 0;
+  for (int w = 0; w < jobs; ++w) threads[w] = std::thread(work, w);
+  for (int w = 0; w < jobs; ++w) threads[w].join();
+  free(text); // names are interned, the AST does not point into the source
+  text = 0;
+  if (errors) { recover = 0; return -1; }
+  merge();
+  // call exit if main returns
+  stub = ncode; emit(PUSH); emit(EXIT);
+  recover = 0;
+  if (src) {
+    for (int f = 0; f < nfuncs; ++f) { if (funcs[f].src) print_code(f); }
+  }
+  return link();
+}
+
+// the VM's memory: null guard, data segment, heap upwards, stack at the top;
+// VM addresses are offsets masked into it
+enum { MemSz = 16 * 1024 * 1024, StackSz = 1024 * 1024 };
+
+// heap: blocks up to MinSz << (Classes - 1) bytes are recycled in size classes, bigger ones are never freed
+enum { MinSz = 8, Classes = 13 };
+
+// printf with VM addresses for %s: one host printf call per conversion
+static int vm_printf(char* mem, int* args) {
+  char f[32];
+  int n = 0;
+  const char* t = mem + (*args++ & (MemSz - 1));
+  while (*t) {
+    const char* s = t;
+    if (*t++ != '%') { while (*t && *t != '%') ++t; n += printf("%.*s", (int) (t - s), s); continue; }
+    while (*t && strchr("0123456789-+ #.lh", *t)) ++t;
+    if (!*t) break;
+    if (t - s > 28 || *t == 'n' || *t == '*') { report(0, "bad printf format"); return -1; }
+    memcpy(f, s, t - s + 1); f[t - s + 1] = 0;
+    if (*t == '%') n += printf("%%");
+    else if (*t == 's') n += printf(f, mem + (*args++ & (MemSz - 1)));
+    else n += printf(f, *args++);
+    ++t;
+  }
+  return n;
 }
 
-static int deinit(int error_code) {
-  if (id) free(id);
-  // free keyword list
-  while (kws) {
-    id = kws; kws = kws->next;
-    free(id);
+int cc_run(int argc, char* argv[]) {
+  int *pc, *sp, *bp, a; // vm registers
+  int* text;            // code, not thread local in the loop
+  int i, cycle, sz;
+  int fl[Classes];      // size class free lists
+  int hp;               // heap bump position
+  char* mem = (char*) malloc(MemSz + 16); // zeroed guard bytes above
+  if (!mem) { report(0, "FATAL: could not malloc(%d) VM memory", MemSz + 16); return -1; }
+  memset(mem, 0, MemSz + 16);
+  if (DataBase + datasz > MemSz - StackSz) { report(0, "FATAL: data segment too large"); free(mem); return -1; }
+  if (datasz) memcpy(mem + DataBase, data, datasz);
+  hp = (DataBase + datasz + sizeof (int) - 1) & -(int) sizeof (int);
+  memset(fl, 0, sizeof fl);
+
+  // arguments on the heap
+  sp = (int*) (mem + hp); hp += argc * sizeof (int);
+  for (i = 0; i < argc; ++i) {
+    sz = strlen(argv[i]) + 1;
+    if (hp + sz > MemSz - StackSz) { report(0, "FATAL: arguments too large"); free(mem); return -1; }
+    sp[i] = hp; memcpy(mem + hp, argv[i], sz); hp += sz;
   }
-  // free global identifier list
-  while (ids) {
-    id = ids; ids = ids->next;
-    free(id);
+  a = (char*) sp - mem;
+  hp = (hp + sizeof (int) - 1) & -(int) sizeof (int);
+
+  // setup stack
+  bp = sp = (int*) (mem + MemSz);
+  *--sp = a;
+  *--sp = argc;
+  *--sp = stub;
+  text = code;
+  pc = text + funcs[intern("main", 4, 0)->val].code;
+
+  // run...
+  a = cycle = 0;
+  while (1) {
+    i = *pc++; ++cycle;
+    if      (i == IMM)   a = *pc++;                                         // load global address or immediate
+    else if (i == LEA)   a = (char*) (bp + *pc++) - mem;                    // load local address
+    else if (i == JMP)   pc = text + *pc;                                   // jump
+    else if (i == JSR)   { *--sp = pc + 1 - text; pc = text + *pc; }        // jump to subroutine
+    else if (i == BZ)    pc = a ? pc + 1 : text + *pc;                      // branch if zero
+    else if (i == BNZ)   pc = a ? text + *pc : pc + 1;                      // branch if not zero
+    else if (i == ENTER) {                                                  // enter subroutine
+      *--sp = (char*) bp - mem; bp = sp; sp = sp - *pc++;
+      if ((char*) sp < mem + MemSz - StackSz) { report(0, "stack overflow! cycle = %d", cycle); free(mem); return -1; }
+    }
+    else if (i == ADJ)   sp = sp + *pc++;                                   // stack adjust
+    else if (i == LEAVE) {                                                  // leave subroutine
+      // the saved frame pointer and return address are on the stack the program writes: keep them in bounds
+      sp = bp; bp = (int*) (mem + MemSz - StackSz + (*sp++ & (StackSz - 1) & -(int) sizeof (int)));
+      if (*sp < 0 || *sp >= ncode) { report(0, "bad return address! cycle = %d", cycle); free(mem); return -1; }
+      pc = text + *sp++;
+    }
+    else if (i == LI)    a = *(int*) (mem + (a & (MemSz - 1)));             // load int
+    else if (i == LC)    a = *(char*) (mem + (a & (MemSz - 1)));            // load char
+    else if (i == SI)    *(int*) (mem + (*sp++ & (MemSz - 1))) = a;         // store int
+    else if (i == SC)    a = *(char*) (mem + (*sp++ & (MemSz - 1))) = a;    // store char
+    else if (i == PUSH)  *--sp = a;                                         // push
+
+    else if (i == OR)  a = *sp++ |  a;
+    else if (i == XOR) a = *sp++ ^  a;
+    else if (i == AND) a = *sp++ &  a;
+    else if (i == EQ)  a = *sp++ == a;
+    else if (i == NE)  a = *sp++ != a;
+    else if (i == LT)  a = *sp++ <  a;
+    else if (i == GT)  a = *sp++ >  a;
+    else if (i == LE)  a = *sp++ <= a;
+    else if (i == GE)  a = *sp++ >= a;
+    else if (i == SHL) a = (unsigned) *sp++ << a;
+    else if (i == SHR) a = *sp++ >> a;
+    else if (i == ADD) a = (unsigned) *sp++ + a;
+    else if (i == SUB) a = (unsigned) *sp++ - a;
+    else if (i == MUL) a = (unsigned) *sp++ * a;
+    else if (i == DIV) { if (!a) { report(0, "division by zero! cycle = %d", cycle); free(mem); return -1; } a = *sp++ / a; }
+    else if (i == MOD) { if (!a) { report(0, "division by zero! cycle = %d", cycle); free(mem); return -1; } a = *sp++ % a; }
+
+    // library calls: arguments first to last from sp; pointer arguments are masked, lengths checked against the end of memory
+    else if (i == OPEN)   a = open(mem + (*sp & (MemSz - 1)), sp[1], 0644);
+    else if (i == READ || i == WRITE) {
+      sp[1] &= MemSz - 1;
+      if (sp[2] < 0 || sp[2] > MemSz - sp[1]) { report(0, "%s out of bounds! cycle = %d", &ops[i * 8], cycle); free(mem); return -1; }
+      if (i == WRITE) fflush(stdout);
+      a = (i == READ) ? read(*sp, mem + sp[1], sp[2]) : write(*sp, mem + sp[1], sp[2]);
+    }
+    else if (i == CLOSE)  a = close(*sp);
+    else if (i == PRINTF) { if ((a = vm_printf(mem, sp)) < 0) { free(mem); return -1; } }
+    else if (i == MALLOC) { // small blocks from their size class free list, others from the heap
+      sz = *sp; a = i = 0;
+      while (i < Classes && (MinSz << i) < sz) ++i;
+      if (i < Classes && fl[i]) { a = fl[i]; fl[i] = *(int*) (mem + a) & (MemSz - 1) & -(int) sizeof (int); } // the link is in the freed block
+      else if (sz >= 0 && sz <= MemSz - StackSz - hp - 2 * (int) sizeof (int)) { // checked before rounding up can overflow
+        if (i < Classes) sz = MinSz << i;
+        sz = ((sz + sizeof (int) - 1) & -(int) sizeof (int)) + sizeof (int); // size class header
+        if (sz <= MemSz - StackSz - hp) { a = hp + sizeof (int); *(int*) (mem + hp) = i; hp += sz; }
+      }
+    }
+    else if (i == FREE) { // small blocks go back to their free list
+      if ((a = *sp & (MemSz - 1) & -(int) sizeof (int)) >= (int) sizeof (int)) {
+        i = *(int*) (mem + a - sizeof (int));
+        if (i >= 0 && i < Classes) { *(int*) (mem + a) = fl[i]; fl[i] = a; }
+      }
+    }
+    else if (i == MEMSET || i == MEMCMP || i == MEMCPY) {
+      *sp &= MemSz - 1;
+      if (i != MEMSET) sp[1] &= MemSz - 1;
+      if (sp[2] < 0 || sp[2] > MemSz - *sp || (i != MEMSET && sp[2] > MemSz - sp[1])) { report(0, "%s out of bounds! cycle = %d", &ops[i * 8], cycle); free(mem); return -1; }
+      if (i == MEMSET) { memset(mem + *sp, sp[1], sp[2]); a = *sp; }
+      else if (i == MEMCMP) a = memcmp(mem + *sp, mem + sp[1], sp[2]);
+      else { memcpy(mem + *sp, mem + sp[1], sp[2]); a = *sp; }
+    }
+    else if (i == EXIT) { fflush(stdout); a = *sp; free(mem); return a; }
+    else { report(0, "unknown instruction = %d! cycle = %d", i, cycle); free(mem); return -1; }
   }
-  // 
+}
+
+int cc_deinit(int error_code) {
+  // free all identifiers and names at once, the AST and IR
+  free_thread();
+  memset(table, 0, sizeof table);
+  // free functions, data and code
+  free(funcs); funcs = 0;
+  nfuncs = maxfuncs = 0;
+  free(data); data = 0;
+  datasz = maxdata = 0;
+  free(strs); strs = 0;
+  nstrs = maxstrs = 0;
+  free(code); code = 0;
+  ncode = maxcode = 0;
+  free(relocs); relocs = 0;
+  nrelocs = maxrelocs = 0;
+  for (int w = 0; w < MaxJobs; ++w) {
+    free(workers[w].code); free(workers[w].strs); free(workers[w].relocs);
+    memset(&workers[w], 0, sizeof (Worker));
+  }
+  enums = structs = 0;
+  errors = stub = 0;
   return error_code;
 }
 
-static int init() {
-  const char* str;
-  ids = 0; kws = 0;
-  str = "auto"; id = new_id(AutoKW, str, get_hash(str), 0); id->next = kws; kws = id;
-  str = "char"; id = new_id(CharKW, str, get_hash(str), 0); id->next = kws; kws = id;
+int cc_init() {
+  jmp_buf env;
+  recover = &env;
+  if (setjmp(env)) { recover = 0; return -1; }
+  // keywords are identifiers of the global scope
+  id = intern("auto", 4, 0); id->tok = AutoKW;
+  id = intern("char", 4, 0); id->tok = CharKW;
   id->val = sizeof (char);
-  str = "enum"; id = new_id(EnumKW, str, get_hash(str), 0); id->next = kws; kws = id;
+  charid = id;
+  id = intern("else", 4, 0); id->tok = ElseKW;
+  id = intern("enum", 4, 0); id->tok = EnumKW;
   id->val = sizeof (int);
-  str = "int"; id = new_id(IntKW, str, get_hash(str), 0); id->next = kws; kws = id;
+  id = intern("if", 2, 0); id->tok = IfKW;
+  id = intern("int", 3, 0); id->tok = IntKW;
   id->val  = sizeof (int);
-  str = "struct"; id = new_id(StructKW, str, get_hash(str), 0); id->next = kws; kws = id;
-  str = "void"; id = new_id(VoidKW, str, get_hash(str), 0); id->next = kws; kws = id;
+  intid = id;
+  id = intern("return", 6, 0); id->tok = ReturnKW;
+  id = intern("sizeof", 6, 0); id->tok = SizeofKW;
+  id = intern("struct", 6, 0); id->tok = StructKW;
+  id = intern("void", 4, 0); id->tok = VoidKW;
+  voidid = id;
+  id = intern("while", 5, 0); id->tok = WhileKW;
+  // library functions are global identifiers
+  for (int i = 0; i < (int) (sizeof library / sizeof library[0]); ++i) {
+    id = intern(library[i].name, strlen(library[i].name), 0);
+    id->tok = Sys; id->val = i; id->ptr = library[i].ptr;
+    id->ref = intern(library[i].type, strlen(library[i].type), 0);
+  }
+  node(Block, 0, 0, 0, voidid, 0); // node 0: no node
+  recover = 0;
   return 0;
 }
 
+// with CC_LIBRARY defined, there is no main; an embedder uses the API in cc.h
+#ifndef CC_LIBRARY
 int main(int argc, char* argv[]) {
-  int ret = init();
-  if (ret != 0) return deinit(ret);
-  ret = compile();
-  if (ret != 0) return deinit(ret);
-  return deinit(ret);
+  --argc; ++argv;
+  if (argc > 0 && **argv == '-' && (*argv)[1] == 's') { src = 1; --argc; ++argv; }
+  if (argc > 1 && **argv == '-' && (*argv)[1] == 'j') { jobs = atoi(argv[1]); argc -= 2; argv += 2; }
+  if (argc < 1 || jobs < 1 || jobs > MaxJobs) { printf("usage: cc [-s] [-j jobs] file ...\n"); return -1; }
+  int ret = cc_init();
+  if (ret != 0) return cc_deinit(ret);
+  ret = cc_compile(*argv);
+  if (ret != 0 || src) return cc_deinit(ret);
+  return cc_deinit(cc_run(argc, argv));
 }
+#endif
@@ -0,0 +1,14 @@
+#ifndef CC_H
+#define CC_H
+
+// cc as a library (cc.cpp built with CC_LIBRARY defined): per input an embedder calls
+// cc_init(), cc_compile(), cc_run() and cc_deinit(); each returns a status, 0 on success
+int cc_init();
+int cc_compile(const char* file);
+int cc_run(int argc, char* argv[]);  // argv[0] is the file compiled; returns the program's exit code
+int cc_deinit(int error_code);       // frees everything, returns error_code
+
+// diagnostics sink: compile and run errors, one message per call; an embedder may replace it
+extern void (*cc_diag)(const char* msg);
+
+#endif
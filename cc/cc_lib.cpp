@@ -0,0 +1,29 @@
+// library test: compiles and runs all inputs in one process, each from a fresh cc_init();
+// inputs named *_fail.c must report errors, the others must compile and exit with 0
+#include <stdio.h>
+#include <string.h>
+#include "cc.h"
+
+static int msgs;  // diagnostics of the current input
+
+static void count_diag(const char* msg) {
+  printf("%s\n", msg);
+  ++msgs;
+}
+
+int main(int argc, char* argv[]) {
+  int failed = 0;
+  cc_diag = count_diag;
+  for (int i = 1; i < argc; ++i) {
+    char* args[] = { argv[i], (char*) "arg_lib" }; // as test.sh passes them
+    msgs = 0;
+    int ret = cc_init();
+    if (ret == 0) ret = cc_compile(argv[i]);
+    if (ret == 0) ret = cc_run(2, args);
+    ret = cc_deinit(ret);
+    int ok = strstr(argv[i], "_fail.c") ? ret != 0 && msgs > 0 : ret == 0 && msgs == 0;
+    printf(ok ? "%s\n" : "%s FAILED\n", argv[i]);
+    if (!ok) failed = 1;
+  }
+  return failed;
+}
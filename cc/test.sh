@@ -0,0 +1,7 @@
+for fn in test/$1_*_ok.c; do
+    ./$1$2 $3 $fn arg_$fn && echo "$fn" || echo "$fn FAILED"
+done
+
+for fn in test/$1_*_fail.c; do
+    ./$1$2 $3 $fn arg_$fn && echo "$fn FAILED"
+done
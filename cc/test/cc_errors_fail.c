@@ -0,0 +1,9 @@
+// one error per declaration; all of them are reported
+struct S { int x; foo y; };
+int a, 5;
+enum E { A, B = a };
+int f(int x) { return x + ; }
+int g(int x) { return y; }
+int h(int x);
+int k;
+int main() { k = f(1) + g(2) + h(3); return k; }
@@ -0,0 +1,22 @@
+int calls;
+
+int fib(int n) { ++calls; if (n < 2) return n; return fib(n - 1) + fib(n - 2); }
+
+int main(int argc, char** argv) {
+  int i, s, *p;
+  char* t;
+
+  if (fib(20) != 6765) { printf("fib(20) != 6765! : %d\n", fib(20)); exit(-1); }
+  i = 5; s = i++ + ++i;
+  if (i != 7 || s != 12) { printf("i++ + ++i failed! : %d %d\n", i, s); exit(-1); }
+  if ((char) 300 != 44) { printf("(char) 300 != 44! : %d\n", (char) 300); exit(-1); }
+  if (-7 / 2 != -3 || -7 % 2 != -1 || 1 << 4 != 16 || (-16 >> 2) != -4) { printf("arithmetic failed!\n"); exit(-1); }
+  if ((3 && 4) != 1 || (0 || 5) != 1 || !(1 || i / 0)) { printf("logical operators failed!\n"); exit(-1); }
+  if ((i > 6 ? 10 : 20) != 10) { printf("conditional failed!\n"); exit(-1); }
+  p = malloc(4 * sizeof(int)); p[3] = 9; p = p + 3;
+  if (*p != 9 || p - (p - 3) != 3) { printf("pointer arithmetic failed!\n"); exit(-1); }
+  t = "hello";
+  if (t[4] != 'o' || memcmp(t, "hel", 3)) { printf("string failed!\n"); exit(-1); }
+  if (argc < 2 || memcmp(argv[1], "arg_", 4)) { printf("bad arguments! argc: %d\n", argc); exit(-1); }
+  return 0;
+}
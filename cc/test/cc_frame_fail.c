@@ -0,0 +1,12 @@
+int f() {
+  int x;
+  int* p;
+  p = &x;
+  p[2] = 1000000000; // overwrite the return address
+  return 0;
+}
+
+int main() {
+  f();
+  return 0;
+}
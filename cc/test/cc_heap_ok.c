@@ -0,0 +1,25 @@
+int main() {
+  int* p;
+  int* q;
+  int* r;
+
+  // a free list link overwritten after free stays inside the VM's memory
+  p = malloc(8);
+  free(p);
+  *p = 200000000;
+  q = malloc(8);
+  r = malloc(8);
+  if (q != p) { printf("freed block not recycled! p:%d q:%d\n", p, q); exit(-1); }
+  *r = 4711;
+  if (*r != 4711) { printf("recycled block store/load mismatch!\n"); exit(-1); }
+
+  // a size that overflows when rounded up fails without harming the heap
+  p = malloc(2147483646);
+  if (p) { printf("malloc(2147483646) succeeded! p:%d\n", p); exit(-1); }
+  p = malloc(100);
+  q = malloc(100);
+  if (!p || !q || p == q) { printf("malloc after failed malloc broken! p:%d q:%d\n", p, q); exit(-1); }
+  *p = 1; *q = 2;
+  if (*p != 1) { printf("blocks after failed malloc overlap!\n"); exit(-1); }
+  return 0;
+}
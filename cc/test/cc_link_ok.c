@@ -0,0 +1,10 @@
+int g() { return 3; }
+int h(int x) { return x + 1; }
+
+int main() {
+  // calls after a function with a small frame: the linker must stay in step with the instructions
+  if (g() != 3) { printf("g() != 3! : %d\n", g()); exit(-1); }
+  if (h(4) != 5) { printf("h(4) != 5! : %d\n", h(4)); exit(-1); }
+  printf("%d %d\n", g(), h(4));
+  return 0;
+}
@@ -0,0 +1,2 @@
+struct S { int a; };
+int main() { struct S s; return s.b; } // no member b
@@ -0,0 +1,15 @@
+int x;
+
+int f(int x) { { int x; x = 3; } return x; }
+
+int main() {
+  int y;
+  x = 1;
+  y = f(2);
+  if (y != 2) { printf("parameter shadowed by inner block! : %d\n", y); exit(-1); }
+  { int x; x = 5; y = x; }
+  if (x != 1 || y != 5) { printf("block scope failed! x: %d y: %d\n", x, y); exit(-1); }
+  { struct x { int a; }; struct x s; s.a = 7; y = s.a; }
+  if (x != 1 || y != 7) { printf("struct in block scope failed! x: %d y: %d\n", x, y); exit(-1); }
+  return 0;
+}
@@ -0,0 +1,30 @@
+struct Node { struct Node* next; char c; int v; };
+enum Color { Red, Green = 5, Blue };
+
+struct Node* push(struct Node* l, int v) {
+  struct Node* n;
+  n = malloc(sizeof(struct Node));
+  n->next = l; n->c = 'a' + v; n->v = v;
+  return n;
+}
+
+int main() {
+  struct Node a, *l;
+  enum Color c;
+  int i, s;
+
+  if (sizeof(struct Node) != 12) { printf("sizeof(struct Node) != 12! : %d\n", sizeof(struct Node)); exit(-1); }
+  if (Blue != 6) { printf("Blue != 6! : %d\n", Blue); exit(-1); }
+  c = Blue;
+  if (c - Green != 1) { printf("c - Green != 1! : %d\n", c - Green); exit(-1); }
+
+  a.next = 0; a.c = 'z'; a.v = 4711;
+  if ((&a)->v != 4711 || a.c != 'z') { printf("member access failed! : %d %c\n", a.v, a.c); exit(-1); }
+
+  l = 0; i = 0;
+  while (i < 10) l = push(l, i++);
+  s = 0;
+  while (l) { s = s + l->v * (l->c == 'a' + l->v); l = l->next; }
+  if (s != 45) { printf("list sum != 45! : %d\n", s); exit(-1); }
+  return 0;
+}
@@ -0,0 +1 @@
+int main() { { int a; a = 1; } return a; } // a undeclared outside its block
@@ -0,0 +1,27 @@
+#!/bin/bash
+# Bootstrap cc500 with the gcc-built compiler $1 (stage0), check that
+# the self-compiled compilers reach a fixed point and time compiling
+# and running the programs in bench/ with stage1.
+# Further arguments, e.g. -m64, are passed to every compiler run.
+
+s0=$1
+shift
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+TIMEFORMAT=%R
+
+$s0 "$@" < cc500.c > $tmp/stage1 && chmod +x $tmp/stage1 || { echo "stage1 FAILED"; exit 1; }
+$tmp/stage1 "$@" < cc500.c > $tmp/stage2 && chmod +x $tmp/stage2 || { echo "stage2 FAILED"; exit 1; }
+$tmp/stage2 "$@" < cc500.c > $tmp/stage3 || { echo "stage3 FAILED"; exit 1; }
+cmp -s $tmp/stage1 $tmp/stage2 && cmp -s $tmp/stage2 $tmp/stage3 &&
+    echo "fixed point ($(wc -c < $tmp/stage1) bytes)" || echo "fixed point FAILED"
+
+t=$( { time $tmp/stage1 "$@" < cc500.c > /dev/null; } 2>&1 )
+echo "cc500.c compile ${t}s"
+
+for fn in bench/bench_*.c; do
+    out=$tmp/$(basename $fn .c)
+    c=$( { time $tmp/stage1 "$@" < $fn > $out; } 2>&1 ) && chmod +x $out || { echo "$fn FAILED"; continue; }
+    r=$( { time $out < cc500.c > /dev/null; } 2>&1 ) &&
+        echo "$fn compile ${c}s run ${r}s size $(wc -c < $out)" || echo "$fn FAILED"
+done
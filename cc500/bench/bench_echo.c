@@ -0,0 +1,9 @@
+/* Character I/O: copy standard input to standard output. */
+int main() {
+  int c = getchar();
+  while (c != 0 - 1) {
+    putchar(c);
+    c = getchar();
+  }
+  return 0;
+}
@@ -0,0 +1,14 @@
+/* Function calls: the naive Fibonacci recursion. */
+int fib(int n);
+
+int main() {
+  if (fib(35) == 9227465)
+    return 0;
+  return 1;
+}
+
+int fib(int n) {
+  if (n <= 1)
+    return n;
+  return fib(n - 1) + fib(n - 2);
+}
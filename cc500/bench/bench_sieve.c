@@ -0,0 +1,32 @@
+/* Byte loops: count the primes below 20000000 with a sieve. */
+int sieve(int n);
+
+int main() {
+  if (sieve(20000000) == 1270607)
+    return 0;
+  return 1;
+}
+
+int sieve(int n) {
+  char *p = malloc(n);
+  int c = 0;
+  int i = 2;
+  int j;
+  while (i <= n - 1) {
+    p[i] = 1;
+    i = i + 1;
+  }
+  i = 2;
+  while (i <= n - 1) {
+    if (p[i]) {
+      c = c + 1;
+      j = i + i;
+      while (j <= n - 1) {
+        p[j] = 0;
+        j = j + i;
+      }
+    }
+    i = i + 1;
+  }
+  return c;
+}
@@ -0,0 +1,64 @@
+/* Word loads and stores: insertion sort of pseudo-random numbers. */
+int sort(int n);
+
+int main() {
+  return sort(5000);
+}
+
+int get(char *p, int i) {
+  p = p + (i << 2);
+  return (p[0] & 255) + ((p[1] & 255) << 8) +
+         ((p[2] & 255) << 16) + ((p[3] & 255) << 24);
+}
+
+void put(char *p, int i, int x) {
+  p = p + (i << 2);
+  p[0] = x;
+  p[1] = x >> 8;
+  p[2] = x >> 16;
+  p[3] = x >> 24;
+}
+
+int sort(int n) {
+  char *p = malloc(n << 2);
+  int x = 1;
+  int sum = 0;
+  int i = 0;
+  int j;
+  int k;
+  while (i <= n - 1) {
+    x = ((x << 5) + x + 12345) & 16777215;
+    put(p, i, x);
+    sum = sum + x;
+    i = i + 1;
+  }
+  i = 1;
+  while (i <= n - 1) {
+    k = get(p, i);
+    j = i;
+    x = 1;
+    while (x) {
+      x = 0;
+      if (1 <= j)
+        if (k <= get(p, j - 1) - 1) {
+          put(p, j, get(p, j - 1));
+          j = j - 1;
+          x = 1;
+        }
+    }
+    put(p, j, k);
+    i = i + 1;
+  }
+  i = 1;
+  while (i <= n - 1) {
+    if (get(p, i) <= get(p, i - 1) - 1)
+      return 1;
+    i = i + 1;
+  }
+  i = 0;
+  while (i <= n - 1) {
+    sum = sum - get(p, i);
+    i = i + 1;
+  }
+  return sum != 0;
+}
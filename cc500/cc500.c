@@ -25,21 +25,23 @@ void exit(int);
 void *malloc(int);
 int getchar(void);
 int putchar(int);
+/*
+ * write and memcpy go by names reserved for the implementation, so that
+ * programs may define their own. Our runtime defines both; a hosted
+ * compiler has __builtin_memcpy and maps __write to write. We skip
+ * preprocessor lines.
+ */
+#include <unistd.h>
+#define __write write
 
 /* The first thing defined must be main(). */
-int compile();
-int main() {
-  return compile();
+int compile(int argc);
+int main(int argc, char **argv) {
+  return compile(argc);
 }
 
 char *my_realloc(char *old, int oldlen, int newlen) {
-  char *new = malloc(newlen);
-  int i = 0;
-  while (i <= oldlen - 1) {
-    new[i] = old[i];
-    i = i + 1;
-  }
-  return new;
+  return __builtin_memcpy(malloc(newlen), old, oldlen);
 }
 
 void error() {
@@ -90,6 +92,11 @@ void get_token() {
           takechar();
         takechar();
       }
+      else if (nextc == '#') {
+        while ((nextc != 10) & (nextc != 0-1))
+          nextc = getchar();
+        w = 1;
+      }
       else if (nextc == '/') {
         takechar();
         if (nextc == '*') {
@@ -136,6 +143,16 @@ int code_size;
 int codepos;
 int code_offset;
 
+/*
+ * Globals and the runtime's variables live in a zero-filled data
+ * segment at data_offset, after the getchar buffer.
+ */
+int data_offset;
+int data_pos;
+
+/* 1 for x86-64 code with 8-byte stack slots, 0 for i386 */
+int x64;
+
 void save_int(char *p, int n) {
   p[0] = n;
   p[1] = n >> 8;
@@ -145,7 +162,7 @@ void save_int(char *p, int n) {
 
 int load_int(char *p) {
   return ((p[0] & 255) + ((p[1] & 255) << 8) +
-          ((p[2] & 255) << 16) + ((p[3] & 255) << 24));
+          ((p[2] & 255) << 16) + (p[3] << 24));
 }
 
 void emit(int n, char *s) {
@@ -162,44 +179,120 @@ void emit(int n, char *s) {
   }
 }
 
+/*
+ * The jumps, stack adjustments and returns of the current function,
+ * from fn_start on, are recorded for the peephole pass as their
+ * position, their kind ('j' for jmp, 'e' for jcc, 'p' or 'r', or 'J'
+ * and 'E' for jumps relaxed to rel8), the number of bytes to cut from
+ * their end and their size. Uses of undefined globals are recorded
+ * right after their address as 'u' with no size and their symbol.
+ */
+char *marks;
+int marks_size;
+int marks_pos;
+int fn_start;
+
+/*
+ * String literals are kept once each in the pool, which be_finish()
+ * maps read-only after the code. Each entry of strs is the offset and
+ * length of a string in the pool and the offset + 1 of the previous
+ * entry in its bucket. str_sites holds the positions of the addresses
+ * in the code that are still relative to the pool.
+ */
+char *pool;
+int pool_size;
+int pool_pos;
+char *strs;
+int strs_size;
+int strs_pos;
+char *str_buckets;
+char *str_sites;
+int str_sites_size;
+int str_sites_pos;
+
+void be_mark(int kind) {
+  if (marks_size <= marks_pos + 12) {
+    int x = (marks_pos + 12) << 1;
+    marks = my_realloc(marks, marks_size, x);
+    marks_size = x;
+  }
+  save_int(marks + marks_pos, codepos);
+  marks[marks_pos + 4] = kind;
+  marks[marks_pos + 5] = 0;
+  marks[marks_pos + 6] = 1;
+  if (kind == 'j')
+    marks[marks_pos + 6] = 5;
+  if (kind == 'e')
+    marks[marks_pos + 6] = 6;
+  if (kind == 'p')
+    marks[marks_pos + 6] = 6 + x64;
+  if (kind == 'u')
+    marks[marks_pos + 6] = 0;
+  marks_pos = marks_pos + 12;
+}
+
 void be_push() {
   emit(1, "\x50"); /* push %eax */
 }
 
 void be_pop(int n) {
-  emit(6, "\x81\xc4...."); /* add $(n * 4),%esp */
-  save_int(code + codepos - 4, n << 2);
+  be_mark('p');
+  if (x64)
+    emit(7, "\x48\x81\xc4...."); /* add $(n * 8),%rsp */
+  else
+    emit(6, "\x81\xc4...."); /* add $(n * 4),%esp */
+  save_int(code + codepos - 4, n << (2 + x64));
 }
 
+/*
+ * Each table entry is the name, a 0, the type, the value and the offset
+ * + 1 of the previous entry whose name hashes to the same bucket.
+ * The buckets hold the offset + 1 of the newest entry in their chain.
+ */
 char *table;
 int table_size;
 int table_pos;
 int stack_pos;
+char *buckets;
+
+int sym_hash(char *s) {
+  int h = 0;
+  int j = 0;
+  while (s[j]) {
+    h = (h << 5) + h + s[j];
+    j = j + 1;
+  }
+  return (h & 1023) << 2;
+}
+
+int sym_link(int t) {
+  while (table[t])
+    t = t + 1;
+  return t + 6;
+}
 
 int sym_lookup(char *s) {
-  int t = 0;
-  int current_symbol = 0;
-  while (t <= table_pos - 1) {
-    i = 0;
-    while ((s[i] == table[t]) & (s[i] != 0)) {
-      i = i + 1;
-      t = t + 1;
-    }
-    if (s[i] == table[t])
-      current_symbol = t;
-    while (table[t] != 0)
-      t = t + 1;
-    t = t + 6;
+  int t = load_int(buckets + sym_hash(s));
+  int j;
+  while (t) {
+    t = t - 1;
+    j = 0;
+    while ((s[j] == table[t + j]) & (s[j] != 0))
+      j = j + 1;
+    if (s[j] == table[t + j])
+      return t + j;
+    t = load_int(table + sym_link(t));
   }
-  return current_symbol;
+  return 0;
 }
 
 void sym_declare(char *s, int type, int value) {
   int t = table_pos;
+  int h = sym_hash(s);
   i = 0;
   while (s[i] != 0) {
-    if (table_size <= t + 10) {
-      int x = (t + 10) << 1;
+    if (table_size <= t + 14) {
+      int x = (t + 14) << 1;
       table = my_realloc(table, table_size, x);
       table_size = x;
     }
@@ -210,23 +303,37 @@ void sym_declare(char *s, int type, int value) {
   table[t] = 0;
   table[t + 1] = type;
   save_int(table + t + 2, value);
-  table_pos = t + 6;
+  save_int(table + t + 6, load_int(buckets + h));
+  save_int(buckets + h, table_pos + 1);
+  table_pos = t + 10;
+}
+
+/* Drop the entries from n on, unlinking them from their chains. */
+void sym_rewind(int n) {
+  int t = n;
+  int h;
+  while (t <= table_pos - 1) {
+    h = sym_hash(table + t);
+    while (n <= load_int(buckets + h) - 1)
+      save_int(buckets + h, load_int(table + sym_link(load_int(buckets + h) - 1)));
+    t = sym_link(t) + 4;
+  }
+  table_pos = n;
 }
 
 int sym_declare_global(char *s) {
   int current_symbol = sym_lookup(s);
   if (current_symbol == 0) {
     sym_declare(s, 'U', code_offset);
-    current_symbol = table_pos - 6;
+    current_symbol = table_pos - 10;
   }
   return current_symbol;
 }
 
-void sym_define_global(int current_symbol) {
+/* Give the symbol the address v and patch its forward references. */
+void sym_define(int t, int v) {
   int i;
   int j;
-  int t = current_symbol;
-  int v = codepos + code_offset;
   if (table[t + 1] != 'U')
     error(); /* symbol redefined */
   i = load_int(table + t + 2) - code_offset;
@@ -239,99 +346,610 @@ void sym_define_global(int current_symbol) {
   save_int(table + t + 2, v);
 }
 
+void sym_define_global(int current_symbol) {
+  sym_define(current_symbol, codepos + code_offset);
+}
+
 int number_of_args;
 
+/*
+ * The address of the variable last loaded into %eax ends at var_pos;
+ * promote() turns it into a load of the variable by patching the
+ * opcode at var_op into var_load.
+ */
+int var_pos;
+int var_op;
+int var_load;
+
+/* A constant loaded into %eax ends at const_pos. */
+int const_pos;
+
+/* A comparison turned into 0 or 1 by setcc ; movzbl ends at cmp_pos. */
+int cmp_pos;
+
 void sym_get_value(char *s) {
   int t;
   if ((t = sym_lookup(s)) == 0)
     error();
-  emit(5, "\xb8...."); /* mov $n,%eax */
-  save_int(code + codepos - 4, load_int(table + t + 2));
-  if (table[t + 1] == 'D') { /* defined global */
+  if ((table[t + 1] == 'D') | (table[t + 1] == 'U')) { /* global */
+    if (x64) {
+      emit(8, "\x48\x8d\x04\x25...."); /* lea n,%rax */
+      var_load = 139; /* mov n,%rax */
+    }
+    else {
+      emit(5, "\xb8...."); /* mov $n,%eax */
+      var_load = 161; /* mov n,%eax */
+    }
+    save_int(code + codepos - 4, load_int(table + t + 2));
+    if (table[t + 1] == 'U') { /* undefined global */
+      save_int(table + t + 2, codepos + code_offset - 4);
+      be_mark('u');
+      save_int(marks + marks_pos - 4, t);
+    }
   }
-  else if (table[t + 1] == 'U') /* undefined global */
-    save_int(table + t + 2, codepos + code_offset - 4);
   else if (table[t + 1] == 'L') { /* local variable */
-    int k = (stack_pos - table[t + 2] - 1) << 2;
-    emit(7, "\x8d\x84\x24...."); /* lea (n * 4)(%esp),%eax */
+    int k = (stack_pos - table[t + 2] - 1) << (2 + x64);
+    if (x64)
+      emit(8, "\x48\x8d\x84\x24...."); /* lea (n * 8)(%rsp),%rax */
+    else
+      emit(7, "\x8d\x84\x24...."); /* lea (n * 4)(%esp),%eax */
     save_int(code + codepos - 4, k);
+    var_load = 139; /* mov (n * 4)(%esp),%eax */
   }
   else if (table[t + 1] == 'A') { /* argument */
-    int k = (stack_pos + number_of_args - table[t + 2] + 1) << 2;
-    emit(7, "\x8d\x84\x24...."); /* lea (n * 4)(%esp),%eax */
+    int k = (stack_pos + number_of_args - table[t + 2] + 1) << (2 + x64);
+    if (x64)
+      emit(8, "\x48\x8d\x84\x24...."); /* lea (n * 8)(%rsp),%rax */
+    else
+      emit(7, "\x8d\x84\x24...."); /* lea (n * 4)(%esp),%eax */
     save_int(code + codepos - 4, k);
+    var_load = 139; /* mov (n * 4)(%esp),%eax */
   }
   else
     error();
+  var_pos = codepos;
+  var_op = codepos - 7;
+  if (var_load == 161)
+    var_op = codepos - 5;
 }
 
+int getchar_data;
+int malloc_data;
+
 void be_start() {
-  /* ELF header */
-  emit(16, "\x7f\x45\x4c\x46\x01\x01\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00");
-  emit(16, "\x02\x00\x03\x00\x01\x00\x00\x00\x54\x80\x04\x08\x34\x00\x00\x00");
-  emit(16, "\x00\x00\x00\x00\x00\x00\x00\x00\x34\x00\x20\x00\x01\x00\x00\x00");
-  emit(4, "\x00\x00\x00\x00");
-  /* program header */
-  emit(12,                 "\x01\x00\x00\x00\x00\x00\x00\x00\x00\x80\x04\x08");
-  emit(16, "\x00\x80\x04\x08\x10\x4b\x00\x00\x10\x4b\x00\x00\x07\x00\x00\x00");
-  emit(4, "\x00\x10\x00\x00");
-  /* call ... ; mov %eax,%ebx ; xor %eax,%eax ; inc %eax ; int $0x80 */
-  emit(12,                 "\xe8\x00\x00\x00\x00\x89\xc3\x31\xc0\x40\xcd\x80");
-
-  sym_define_global(sym_declare_global("exit"));
-  /* pop %ebx ; pop %ebx ; xor %eax,%eax ; inc %eax ; int $0x80 */
-  emit(7, "\x5b\x5b\x31\xc0\x40\xcd\x80");
-
-  sym_define_global(sym_declare_global("malloc"));
-  /* mov 4(%esp),%eax */
-  emit(4, "\x8b\x44\x24\x04");
-  /* push %eax ; xor %ebx,%ebx ; mov $45,%eax ; int $0x80 */
-  emit(10, "\x50\x31\xdb\xb8\x2d\x00\x00\x00\xcd\x80");
-  /* pop %ebx ; add %eax,%ebx ; push %eax ; push %ebx ; mov $45,%eax */
-  emit(10, "\x5b\x01\xc3\x50\x53\xb8\x2d\x00\x00\x00");
-  /* int $0x80 ; pop %ebx ; cmp %eax,%ebx ; pop %eax ; je . + 7 */
-  emit(8, "\xcd\x80\x5b\x39\xc3\x58\x74\x05");
-  /* mov $-1,%eax ; ret */
-  emit(6, "\xb8\xff\xff\xff\xff\xc3");
-
-  sym_define_global(sym_declare_global("getchar"));
-  /* mov $3,%eax ; xor %ebx,%ebx ; push %ebx ; mov %esp,%ecx */
-  emit(10, "\xb8\x03\x00\x00\x00\x31\xdb\x53\x89\xe1");
-  /* xor %edx,%edx ; inc %edx ; int $0x80 */
-  /* test %eax,%eax ; pop %eax ; jne . + 7 */
-  emit(10, "\x31\xd2\x42\xcd\x80\x85\xc0\x58\x75\x05");
-  /* mov $-1,%eax ; ret */
-  emit(6, "\xb8\xff\xff\xff\xff\xc3");
-
-  sym_define_global(sym_declare_global("putchar"));
-  /* mov $4,%eax ; xor %ebx,%ebx ; inc %ebx */
-  emit(8, "\xb8\x04\x00\x00\x00\x31\xdb\x43");
-  /*  lea 4(%esp),%ecx ; mov %ebx,%edx ; int $0x80 ; ret */
-  emit(9, "\x8d\x4c\x24\x04\x89\xda\xcd\x80\xc3");
-
-  save_int(code + 85, codepos - 89); /* entry set to first thing in file */
+  int entry;
+  if (x64) {
+    /* ELF64 header */
+    emit(16, "\x7f\x45\x4c\x46\x02\x01\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00");
+    emit(16, "\x02\x00\x3e\x00\x01\x00\x00\x00\xe8\x00\x40\x00\x00\x00\x00\x00");
+    emit(16, "\x40\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00");
+    emit(16, "\x00\x00\x00\x00\x40\x00\x38\x00\x03\x00\x00\x00\x00\x00\x00\x00");
+    /* program headers: code, the string pool and data */
+    emit(16, "\x01\x00\x00\x00\x05\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00");
+    emit(16, "\x00\x00\x40\x00\x00\x00\x00\x00\x00\x00\x40\x00\x00\x00\x00\x00");
+    emit(16, "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00");
+    emit(8, "\x00\x10\x00\x00\x00\x00\x00\x00");
+    emit(16, "\x01\x00\x00\x00\x04\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00");
+    emit(16, "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00");
+    emit(16, "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00");
+    emit(8, "\x00\x10\x00\x00\x00\x00\x00\x00");
+    emit(16, "\x01\x00\x00\x00\x06\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00");
+    emit(16, "\x00\x00\x00\x20\x00\x00\x00\x00\x00\x00\x00\x20\x00\x00\x00\x00");
+    emit(16, "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00");
+    emit(8, "\x00\x10\x00\x00\x00\x00\x00\x00");
+    /* mov (%rsp),%rax ; lea 8(%rsp),%rbx ; push %rax ; push %rbx ; call ... */
+    emit(16, "\x48\x8b\x04\x24\x48\x8d\x5c\x24\x08\x50\x53\xe8\x00\x00\x00\x00");
+    entry = codepos;
+    /* mov %rax,%rdi ; mov $60,%eax ; syscall */
+    emit(10, "\x48\x89\xc7\xb8\x3c\x00\x00\x00\x0f\x05");
+
+    sym_define_global(sym_declare_global("exit"));
+    /* mov 8(%rsp),%rdi ; mov $60,%eax ; syscall */
+    emit(12, "\x48\x8b\x7c\x24\x08\xb8\x3c\x00\x00\x00\x0f\x05");
+
+    /* malloc arena: position and end of the space taken with brk */
+    malloc_data = data_offset + data_pos;
+    data_pos = data_pos + 16;
+
+    sym_define_global(sym_declare_global("malloc"));
+    /* mov pos,%rax ; mov 8(%rsp),%rsi ; add $7,%rsi ; and $-8,%rsi */
+    emit(8, "\x48\x8b\x04\x25....");
+    save_int(code + codepos - 4, malloc_data);
+    emit(13, "\x48\x8b\x74\x24\x08\x48\x83\xc6\x07\x48\x83\xe6\xf8");
+    /* lea (%rax,%rsi),%rdx ; cmp end,%rdx ; jbe . + 80 */
+    emit(14, "\x48\x8d\x14\x30\x48\x3b\x14\x25....\x76\x4e");
+    save_int(code + codepos - 6, malloc_data + 8);
+    /* test %rax,%rax ; jne . + 19 ; mov $12,%eax ; xor %edi,%edi ; syscall ; mov %rax,pos */
+    emit(22, "\x48\x85\xc0\x75\x11\xb8\x0c\x00\x00\x00\x31\xff\x0f\x05\x48\x89\x04\x25....");
+    save_int(code + codepos - 4, malloc_data);
+    /* mov pos,%rax ; lea 0x400000(%rax,%rsi),%rdi ; mov $12,%eax ; syscall */
+    emit(8, "\x48\x8b\x04\x25....");
+    save_int(code + codepos - 4, malloc_data);
+    emit(15, "\x48\x8d\xbc\x30\x00\x00\x40\x00\xb8\x0c\x00\x00\x00\x0f\x05");
+    /* cmp %rax,%rdi ; je . + 10 ; mov $-1,%rax ; ret */
+    emit(13, "\x48\x39\xc7\x74\x08\x48\xc7\xc0\xff\xff\xff\xff\xc3");
+    /* mov %rax,end ; mov pos,%rax ; lea (%rax,%rsi),%rdx */
+    emit(8, "\x48\x89\x04\x25....");
+    save_int(code + codepos - 4, malloc_data + 8);
+    emit(8, "\x48\x8b\x04\x25....");
+    save_int(code + codepos - 4, malloc_data);
+    emit(4, "\x48\x8d\x14\x30");
+    /* mov %rdx,pos ; ret */
+    emit(9, "\x48\x89\x14\x25....\xc3");
+    save_int(code + codepos - 5, malloc_data);
+
+    sym_define_global(sym_declare_global("__builtin_memcpy"));
+    /* push %rsi ; push %rdi ; mov 24(%rsp),%rcx ; mov 32(%rsp),%rsi ; mov 40(%rsp),%rdi */
+    emit(17, "\x56\x57\x48\x8b\x4c\x24\x18\x48\x8b\x74\x24\x20\x48\x8b\x7c\x24\x28");
+    /* mov %rdi,%rax ; mov %rcx,%rdx ; shr $3,%rcx ; rep movsq */
+    emit(13, "\x48\x89\xf8\x48\x89\xca\x48\xc1\xe9\x03\xf3\x48\xa5");
+    /* mov %rdx,%rcx ; and $7,%rcx ; rep movsb ; pop %rdi ; pop %rsi ; ret */
+    emit(12, "\x48\x89\xd1\x48\x83\xe1\x07\xf3\xa4\x5f\x5e\xc3");
+
+    /* getchar read-ahead: position and end in the buffer */
+    getchar_data = data_offset + data_pos;
+    data_pos = data_pos + 16;
+
+    sym_define_global(sym_declare_global("getchar"));
+    /* mov pos,%rax ; cmp end,%rax ; jne . + 48 */
+    emit(8, "\x48\x8b\x04\x25....");
+    save_int(code + codepos - 4, getchar_data);
+    emit(10, "\x48\x3b\x04\x25....\x75\x2e");
+    save_int(code + codepos - 6, getchar_data + 8);
+    /* xor %eax,%eax ; xor %edi,%edi ; lea buf,%rsi ; mov $65536,%edx ; syscall */
+    emit(12, "\x31\xc0\x31\xff\x48\x8d\x34\x25....");
+    save_int(code + codepos - 4, data_offset);
+    emit(7, "\xba\x00\x00\x01\x00\x0f\x05");
+    /* test %rax,%rax ; jg . + 10 ; mov $-1,%rax ; ret */
+    emit(13, "\x48\x85\xc0\x7f\x08\x48\xc7\xc0\xff\xff\xff\xff\xc3");
+    /* add %rsi,%rax ; mov %rax,end ; mov %rsi,%rax */
+    emit(11, "\x48\x01\xf0\x48\x89\x04\x25....");
+    save_int(code + codepos - 4, getchar_data + 8);
+    emit(3, "\x48\x89\xf0");
+    /* movzbl (%rax),%ecx ; inc %rax ; mov %rax,pos ; mov %ecx,%eax ; ret */
+    emit(14, "\x0f\xb6\x08\x48\xff\xc0\x48\x89\x04\x25....");
+    save_int(code + codepos - 4, getchar_data);
+    emit(3, "\x89\xc8\xc3");
+
+    sym_define_global(sym_declare_global("putchar"));
+    /* mov $1,%eax ; mov %eax,%edi ; lea 8(%rsp),%rsi */
+    emit(12, "\xb8\x01\x00\x00\x00\x89\xc7\x48\x8d\x74\x24\x08");
+    /* mov %eax,%edx ; syscall ; ret */
+    emit(5, "\x89\xc2\x0f\x05\xc3");
+
+    sym_define_global(sym_declare_global("__write"));
+    /* mov $1,%eax ; mov 24(%rsp),%rdi ; mov 16(%rsp),%rsi */
+    emit(15, "\xb8\x01\x00\x00\x00\x48\x8b\x7c\x24\x18\x48\x8b\x74\x24\x10");
+    /* mov 8(%rsp),%rdx ; syscall ; ret */
+    emit(8, "\x48\x8b\x54\x24\x08\x0f\x05\xc3");
+  }
+  else {
+    /* ELF header */
+    emit(16, "\x7f\x45\x4c\x46\x01\x01\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00");
+    emit(16, "\x02\x00\x03\x00\x01\x00\x00\x00\x94\x80\x04\x08\x34\x00\x00\x00");
+    emit(16, "\x00\x00\x00\x00\x00\x00\x00\x00\x34\x00\x20\x00\x03\x00\x00\x00");
+    emit(4, "\x00\x00\x00\x00");
+    /* program headers: code, the string pool and data */
+    emit(12,                 "\x01\x00\x00\x00\x00\x00\x00\x00\x00\x80\x04\x08");
+    emit(16, "\x00\x80\x04\x08\x10\x4b\x00\x00\x10\x4b\x00\x00\x05\x00\x00\x00");
+    emit(4, "\x00\x10\x00\x00");
+    emit(16, "\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00");
+    emit(16, "\x00\x00\x00\x00\x00\x00\x00\x00\x04\x00\x00\x00\x00\x10\x00\x00");
+    emit(16, "\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x20\x00\x00\x00\x20");
+    emit(16, "\x00\x00\x00\x00\x00\x00\x00\x00\x06\x00\x00\x00\x00\x10\x00\x00");
+    /* mov (%esp),%eax ; lea 4(%esp),%ebx ; push %eax ; push %ebx ; call ... */
+    emit(14, "\x8b\x04\x24\x8d\x5c\x24\x04\x50\x53\xe8\x00\x00\x00\x00");
+    entry = codepos;
+    /* mov %eax,%ebx ; xor %eax,%eax ; inc %eax ; int $0x80 */
+    emit(7, "\x89\xc3\x31\xc0\x40\xcd\x80");
+
+    sym_define_global(sym_declare_global("exit"));
+    /* pop %ebx ; pop %ebx ; xor %eax,%eax ; inc %eax ; int $0x80 */
+    emit(7, "\x5b\x5b\x31\xc0\x40\xcd\x80");
+
+    /* malloc arena: position and end of the space taken with brk */
+    malloc_data = data_offset + data_pos;
+    data_pos = data_pos + 8;
+
+    sym_define_global(sym_declare_global("malloc"));
+    /* mov pos,%eax ; mov 4(%esp),%ecx ; add $3,%ecx ; and $-4,%ecx */
+    emit(5, "\xa1....");
+    save_int(code + codepos - 4, malloc_data);
+    emit(10, "\x8b\x4c\x24\x04\x83\xc1\x03\x83\xe1\xfc");
+    /* lea (%eax,%ecx),%edx ; cmp end,%edx ; jbe . + 62 */
+    emit(11, "\x8d\x14\x08\x3b\x15....\x76\x3c");
+    save_int(code + codepos - 6, malloc_data + 4);
+    /* test %eax,%eax ; jne . + 16 ; mov $45,%eax ; xor %ebx,%ebx ; int $0x80 ; mov %eax,pos */
+    emit(18, "\x85\xc0\x75\x0e\xb8\x2d\x00\x00\x00\x31\xdb\xcd\x80\xa3....");
+    save_int(code + codepos - 4, malloc_data);
+    /* mov pos,%eax ; lea 0x400000(%eax,%ecx),%ebx ; mov $45,%eax ; int $0x80 */
+    emit(5, "\xa1....");
+    save_int(code + codepos - 4, malloc_data);
+    emit(14, "\x8d\x9c\x08\x00\x00\x40\x00\xb8\x2d\x00\x00\x00\xcd\x80");
+    /* cmp %eax,%ebx ; je . + 8 ; mov $-1,%eax ; ret */
+    emit(10, "\x39\xc3\x74\x06\xb8\xff\xff\xff\xff\xc3");
+    /* mov %eax,end ; mov pos,%eax ; lea (%eax,%ecx),%edx */
+    emit(5, "\xa3....");
+    save_int(code + codepos - 4, malloc_data + 4);
+    emit(5, "\xa1....");
+    save_int(code + codepos - 4, malloc_data);
+    emit(3, "\x8d\x14\x08");
+    /* mov %edx,pos ; ret */
+    emit(7, "\x89\x15....\xc3");
+    save_int(code + codepos - 5, malloc_data);
+
+    sym_define_global(sym_declare_global("__builtin_memcpy"));
+    /* push %esi ; push %edi ; mov 12(%esp),%ecx ; mov 16(%esp),%esi ; mov 20(%esp),%edi */
+    emit(14, "\x56\x57\x8b\x4c\x24\x0c\x8b\x74\x24\x10\x8b\x7c\x24\x14");
+    /* mov %edi,%eax ; mov %ecx,%edx ; shr $2,%ecx ; rep movsl */
+    emit(9, "\x89\xf8\x89\xca\xc1\xe9\x02\xf3\xa5");
+    /* mov %edx,%ecx ; and $3,%ecx ; rep movsb ; pop %edi ; pop %esi ; ret */
+    emit(10, "\x89\xd1\x83\xe1\x03\xf3\xa4\x5f\x5e\xc3");
+
+    /* getchar read-ahead: position and end in the buffer */
+    getchar_data = data_offset + data_pos;
+    data_pos = data_pos + 8;
+
+    sym_define_global(sym_declare_global("getchar"));
+    /* mov pos,%eax ; cmp end,%eax ; jne . + 41 */
+    emit(5, "\xa1....");
+    save_int(code + codepos - 4, getchar_data);
+    emit(8, "\x3b\x05....\x75\x27");
+    save_int(code + codepos - 6, getchar_data + 4);
+    /* mov $3,%eax ; xor %ebx,%ebx ; lea buf,%ecx ; mov $65536,%edx ; int $0x80 */
+    emit(7, "\xb8\x03\x00\x00\x00\x31\xdb");
+    emit(6, "\x8d\x0d....");
+    save_int(code + codepos - 4, data_offset);
+    emit(7, "\xba\x00\x00\x01\x00\xcd\x80");
+    /* test %eax,%eax ; jg . + 8 ; mov $-1,%eax ; ret */
+    emit(10, "\x85\xc0\x7f\x06\xb8\xff\xff\xff\xff\xc3");
+    /* add %ecx,%eax ; mov %eax,end ; mov %ecx,%eax */
+    emit(7, "\x01\xc8\xa3....");
+    save_int(code + codepos - 4, getchar_data + 4);
+    emit(2, "\x89\xc8");
+    /* movzbl (%eax),%ecx ; inc %eax ; mov %eax,pos ; mov %ecx,%eax ; ret */
+    emit(9, "\x0f\xb6\x08\x40\xa3....");
+    save_int(code + codepos - 4, getchar_data);
+    emit(3, "\x89\xc8\xc3");
+
+    sym_define_global(sym_declare_global("putchar"));
+    /* mov $4,%eax ; xor %ebx,%ebx ; inc %ebx */
+    emit(8, "\xb8\x04\x00\x00\x00\x31\xdb\x43");
+    /*  lea 4(%esp),%ecx ; mov %ebx,%edx ; int $0x80 ; ret */
+    emit(9, "\x8d\x4c\x24\x04\x89\xda\xcd\x80\xc3");
+
+    sym_define_global(sym_declare_global("__write"));
+    /* mov $4,%eax ; mov 12(%esp),%ebx ; mov 8(%esp),%ecx */
+    emit(13, "\xb8\x04\x00\x00\x00\x8b\x5c\x24\x0c\x8b\x4c\x24\x08");
+    /* mov 4(%esp),%edx ; int $0x80 ; ret */
+    emit(7, "\x8b\x54\x24\x04\xcd\x80\xc3");
+  }
+
+  save_int(code + entry - 4, codepos - entry); /* entry calls the first thing in file */
 }
 
+/*
+ * The string pool follows the code in the file and is mapped on the
+ * page after it, at the same offset in its page.
+ */
 void be_finish() {
-  save_int(code + 68, codepos);
-  save_int(code + 72, codepos);
-  i = 0;
-  while (i <= codepos - 1) {
-    putchar(code[i]);
-    i = i + 1;
+  int p = codepos;
+  int v = ((code_offset + p + 4095) >> 12 << 12) + (p & 4095);
+  int k = 0;
+  while (k <= str_sites_pos - 1) {
+    i = load_int(str_sites + k);
+    save_int(code + i, load_int(code + i) + v);
+    k = k + 4;
+  }
+  emit(pool_pos, pool);
+  if (x64) {
+    save_int(code + 96, p);
+    save_int(code + 104, p);
+    save_int(code + 128, p);
+    save_int(code + 136, v);
+    save_int(code + 144, v);
+    save_int(code + 152, pool_pos);
+    save_int(code + 160, pool_pos);
+    save_int(code + 216, data_pos);
+  }
+  else {
+    save_int(code + 68, p);
+    save_int(code + 72, p);
+    save_int(code + 88, p);
+    save_int(code + 92, v);
+    save_int(code + 96, v);
+    save_int(code + 100, pool_pos);
+    save_int(code + 104, pool_pos);
+    save_int(code + 136, data_pos);
+  }
+  __write(1, code, codepos);
+}
+
+int be_jump(int m) {
+  return (marks[m + 4] == 'j') | (marks[m + 4] == 'e') |
+         (marks[m + 4] == 'J') | (marks[m + 4] == 'E');
+}
+
+int be_target(int m) {
+  int p = load_int(marks + m) + marks[m + 6];
+  return p + load_int(code + p - 4);
+}
+
+int be_is_target(int p) {
+  int m = 0;
+  while (m <= marks_pos - 1) {
+    if (be_jump(m) & (marks[m + 5] == 0))
+      if (be_target(m) == p)
+        return 1;
+    m = m + 12;
+  }
+  return 0;
+}
+
+/* Where p ends up once the cut bytes are gone. */
+int be_newpos(int p) {
+  int m = 0;
+  int n = p;
+  while (m <= marks_pos - 1) {
+    if (load_int(marks + m) + marks[m + 6] - marks[m + 5] <= p - 1)
+      n = n - marks[m + 5];
+    m = m + 12;
+  }
+  return n;
+}
+
+/*
+ * Peephole pass over the current function: jumps to jumps are threaded
+ * and jumps to a return become one, then jumps to the next instruction,
+ * adds of 0 to %esp and marked code right after a jump or return that
+ * nothing jumps to are cut. Jumps that reach their target with a rel8
+ * are then shortened until none is left. The jumps and the forward
+ * references in the symbol table are patched before the code is closed
+ * up.
+ */
+void be_peephole() {
+  int m = 0;
+  int n;
+  int p;
+  int t;
+  int dead = 0;
+  int end = 0;
+  char *q;
+  while (m <= marks_pos - 1) {
+    n = 8;
+    p = load_int(marks + m);
+    while (be_jump(m) & (n != 0)) {
+      t = be_target(m);
+      n = n - 1;
+      if ((t == p + marks[m + 6]) | (codepos <= t))
+        n = 0;
+      else if ((code[t] & 255) == 233) /* jmp */
+        save_int(code + p + marks[m + 6] - 4,
+                 t + 5 + load_int(code + t + 1) - p - marks[m + 6]);
+      else if (((code[t] & 255) == 195) & (marks[m + 4] == 'j')) { /* ret */
+        code[p] = code[t];
+        marks[m + 4] = 'r';
+        marks[m + 5] = 4;
+      }
+      else
+        n = 0;
+    }
+    m = m + 12;
+  }
+
+  m = 0;
+  while (m <= marks_pos - 1) {
+    p = load_int(marks + m);
+    if (p != end)
+      dead = 0;
+    if (dead & (be_is_target(p) == 0))
+      marks[m + 5] = marks[m + 6];
+    else {
+      dead = 0;
+      if ((marks[m + 4] == 'j') & (be_target(m) == p + 5))
+        marks[m + 5] = 5;
+      else if ((marks[m + 4] == 'p') & (load_int(code + p + marks[m + 6] - 4) == 0))
+        marks[m + 5] = marks[m + 6];
+      else
+        dead = (marks[m + 4] == 'j') | (marks[m + 4] == 'r');
+    }
+    end = p + marks[m + 6];
+    m = m + 12;
+  }
+
+  n = 1;
+  while (n) {
+    n = 0;
+    m = 0;
+    while (m <= marks_pos - 1) {
+      p = load_int(marks + m);
+      if (((marks[m + 4] == 'j') | (marks[m + 4] == 'e')) & (marks[m + 5] == 0)) {
+        t = be_newpos(be_target(m)) - be_newpos(p) - 2;
+        if ((0 - 128 <= t) & (t <= 127)) {
+          if (marks[m + 4] == 'j')
+            marks[m + 4] = 'J';
+          else
+            marks[m + 4] = 'E';
+          marks[m + 5] = marks[m + 6] - 2;
+          n = 1;
+        }
+      }
+      m = m + 12;
+    }
+  }
+
+  m = 0;
+  while (m <= marks_pos - 1) {
+    if (be_jump(m) & (marks[m + 5] != marks[m + 6])) {
+      p = load_int(marks + m);
+      t = be_newpos(be_target(m)) - be_newpos(p + marks[m + 6]);
+      if (marks[m + 4] == 'J')
+        code[p] = 235; /* jmp rel8 */
+      if (marks[m + 4] == 'E')
+        code[p] = code[p + 1] - 16; /* jcc rel8 */
+      if ((marks[m + 4] == 'J') | (marks[m + 4] == 'E'))
+        code[p + 1] = t;
+      else
+        save_int(code + p + marks[m + 6] - 4, t);
+    }
+    m = m + 12;
+  }
+
+  m = 0;
+  while (m <= marks_pos - 1) {
+    if (marks[m + 4] == 'u') {
+      p = load_int(marks + m) - 4;
+      q = table + load_int(marks + m + 8) + 2;
+      t = load_int(code + p) - code_offset;
+      if (fn_start <= t)
+        save_int(code + p, be_newpos(t) + code_offset);
+      if (load_int(q) - code_offset == p)
+        save_int(q, be_newpos(p) + code_offset);
+    }
+    m = m + 12;
+  }
+
+  n = str_sites_pos;
+  while (n) {
+    n = n - 4;
+    p = load_int(str_sites + n);
+    if (p <= fn_start - 1)
+      n = 0;
+    else
+      save_int(str_sites + n, be_newpos(p));
+  }
+
+  m = 0;
+  n = fn_start;
+  p = fn_start;
+  while (p <= codepos - 1) {
+    t = codepos;
+    if (m <= marks_pos - 1)
+      t = load_int(marks + m) + marks[m + 6] - marks[m + 5];
+    while (p <= t - 1) {
+      code[n] = code[p];
+      n = n + 1;
+      p = p + 1;
+    }
+    if (m <= marks_pos - 1)
+      p = p + marks[m + 5];
+    m = m + 12;
+  }
+  codepos = n;
+  marks_pos = 0;
+  var_pos = 0;
+  const_pos = 0;
+  cmp_pos = 0;
+}
+
+/* Load n into %eax, sign-extended on x86-64. */
+void be_const(int n) {
+  emit(5, "\xb8...."); /* mov $n,%eax */
+  save_int(code + codepos - 4, n);
+  if (x64 & (code[codepos - 1] <= 0 - 1)) {
+    codepos = codepos - 5;
+    emit(7, "\x48\xc7\xc0...."); /* mov $n,%rax */
+    save_int(code + codepos - 4, n);
+  }
+  const_pos = codepos;
+}
+
+/* The size of the constant load that ends at p. */
+int be_const_size(int p) {
+  if (x64 & (code[p - 1] <= 0 - 1))
+    return 7;
+  return 5;
+}
+
+/*
+ * Jump if %eax is 0. A comparison that ends at cmp_pos jumps on its
+ * flags instead, with the opposite condition of its setcc.
+ */
+void be_branch() {
+  int k;
+  if (cmp_pos == codepos) {
+    k = code[codepos - 5] - 16;
+    codepos = codepos - 6;
+    be_mark('e');
+    emit(6, "\x0f\x80...."); /* jcc ... */
+    code[codepos - 5] = k + 1 - ((k & 1) << 1);
+  }
+  else {
+    if (x64)
+      emit(3, "\x48\x85\xc0"); /* test %rax,%rax */
+    else
+      emit(2, "\x85\xc0"); /* test %eax,%eax */
+    be_mark('e');
+    emit(6, "\x0f\x84...."); /* je ... */
   }
 }
 
 void promote(int type) {
   /* 1 = char lval, 2 = int lval, 3 = other */
-  if (type == 1)
-    emit(3, "\x0f\xbe\x00"); /* movsbl (%eax),%eax */
-  else if (type == 2)
-    emit(2, "\x8b\x00"); /* mov (%eax),%eax */
+  if (type == 1) {
+    if (x64)
+      emit(4, "\x48\x0f\xbe\x00"); /* movsbq (%rax),%rax */
+    else
+      emit(3, "\x0f\xbe\x00"); /* movsbl (%eax),%eax */
+  }
+  else if (type == 2) {
+    if (var_pos == codepos)
+      code[var_op] = var_load;
+    else if (x64)
+      emit(3, "\x48\x8b\x00"); /* mov (%rax),%rax */
+    else
+      emit(2, "\x8b\x00"); /* mov (%eax),%eax */
+  }
 }
 
 int expression();
 
+/* The offset in the pool of the first n bytes of token, added if new. */
+int pool_add(int n) {
+  int h = 0;
+  int j = 0;
+  int t;
+  while (j <= n - 1) {
+    h = (h << 5) + h + token[j];
+    j = j + 1;
+  }
+  h = (h & 1023) << 2;
+  t = load_int(str_buckets + h);
+  while (t) {
+    t = t - 1;
+    if (load_int(strs + t + 4) == n) {
+      j = 0;
+      while (j <= n - 1) {
+        if (pool[load_int(strs + t) + j] == token[j])
+          j = j + 1;
+        else
+          j = n + 1;
+      }
+      if (j == n)
+        return load_int(strs + t);
+    }
+    t = load_int(strs + t + 8);
+  }
+  if (strs_size <= strs_pos + 12) {
+    int x = (strs_pos + 12) << 1;
+    strs = my_realloc(strs, strs_size, x);
+    strs_size = x;
+  }
+  save_int(strs + strs_pos, pool_pos);
+  save_int(strs + strs_pos + 4, n);
+  save_int(strs + strs_pos + 8, load_int(str_buckets + h));
+  save_int(str_buckets + h, strs_pos + 1);
+  strs_pos = strs_pos + 12;
+  if (pool_size <= pool_pos + n) {
+    int x = (pool_pos + n) << 1;
+    pool = my_realloc(pool, pool_size, x);
+    pool_size = x;
+  }
+  __builtin_memcpy(pool + pool_pos, token, n);
+  pool_pos = pool_pos + n;
+  return pool_pos - n;
+}
+
 /*
  * primary-expr:
  *     identifier
@@ -347,11 +965,10 @@ int primary_expr() {
       n = (n << 1) + (n << 3) + token[i] - '0';
       i = i + 1;
     }
-    emit(5, "\xb8...."); /* mov $x,%eax */
-    save_int(code + codepos - 4, n);
+    be_const(n);
     type = 3;
   }
-  else if (('a' <= token[0]) & (token[0] <= 'z')) {
+  else if ((('a' <= token[0]) & (token[0] <= 'z')) | (token[0] == '_')) {
     sym_get_value(token);
     type = 2;
   }
@@ -362,8 +979,7 @@ int primary_expr() {
   }
   else if ((token[0] == 39) & (token[1] != 0) &
            (token[2] == 39) & (token[3] == 0)) {
-    emit(5, "\xb8...."); /* mov $x,%eax */
-    save_int(code + codepos - 4, token[1]);
+    be_const(token[1]);
     type = 3;
   }
   else if (token[0] == '"') {
@@ -391,11 +1007,15 @@ int primary_expr() {
       i = i + 1;
     }
     token[i] = 0;
-    /* call ... ; the string ; pop %eax */
-    emit(5, "\xe8....");
-    save_int(code + codepos - 4, i + 1);
-    emit(i + 1, token);
-    emit(1, "\x58");
+    emit(5, "\xb8...."); /* mov $s,%eax */
+    save_int(code + codepos - 4, pool_add(i + 1));
+    if (str_sites_size <= str_sites_pos + 4) {
+      int x = (str_sites_pos + 4) << 1;
+      str_sites = my_realloc(str_sites, str_sites_size, x);
+      str_sites_size = x;
+    }
+    save_int(str_sites + str_sites_pos, codepos - 4);
+    str_sites_pos = str_sites_pos + 4;
     type = 3;
   }
   else
@@ -404,16 +1024,117 @@ int primary_expr() {
   return type;
 }
 
-void binary1(int type) {
+/*
+ * Is the current token a variable or constant that ends the operand?
+ * Such an operand is loaded without touching %ecx.
+ */
+int simple_operand() {
+  if ((nextc == ')') | (nextc == ';') | (nextc == ',') | (nextc == ']'))
+    return (('a' <= token[0]) & (token[0] <= 'z')) | (token[0] == '_') |
+           (('0' <= token[0]) & (token[0] <= '9')) | (token[0] == 39);
+  return 0;
+}
+
+/*
+ * The left operand waits in %ecx if the right one is simple, else on
+ * the stack. Returns 1 for %ecx, plus 2 if it is a constant.
+ */
+int binary1(int type) {
+  int c = 0;
   promote(type);
+  if (const_pos == codepos)
+    c = 2;
+  if (simple_operand()) {
+    if (x64)
+      emit(3, "\x48\x89\xc1"); /* mov %rax,%rcx */
+    else
+      emit(2, "\x89\xc1"); /* mov %eax,%ecx */
+    return 1 + c;
+  }
   be_push();
   stack_pos = stack_pos + 1;
+  return c;
 }
 
-int binary2(int type, int n, char *s) {
+/* The value of a op b, with op as passed to binary2(). */
+int fold(int op, int a, int b) {
+  if (op == '+')
+    return a + b;
+  if (op == '-')
+    return a - b;
+  if (op == '<')
+    return a << b;
+  if (op == '>')
+    return a >> b;
+  if (op == 'l')
+    return a <= b;
+  if (op == '=')
+    return a == b;
+  if (op == '!')
+    return a != b;
+  if (op == '&')
+    return a & b;
+  return a | b;
+}
+
+/*
+ * Does a op b fold to the value computed at run time? x86-64 computes
+ * in 64 bits, so there the result has to fit the sign-extended 32-bit
+ * immediate of be_const().
+ */
+int fold_fits(int op, int a, int b) {
+  if (x64 == 0)
+    return 1;
+  if ((op == '+') | (op == '-'))
+    return (((a >> 30) == 0) | ((a >> 30) == 0 - 1)) &
+           (((b >> 30) == 0) | ((b >> 30) == 0 - 1));
+  if (op == '<')
+    return ((a >> (31 - b)) == 0) | ((a >> (31 - b)) == 0 - 1);
+  return 1;
+}
+
+/*
+ * Emit the operator op: s takes the left operand from the stack, t
+ * from %ecx and u, with a "...." placeholder for the immediate,
+ * replaces the loading of a constant right operand. Two constants are
+ * folded into one, except for shifts out of range and results that
+ * fold_fits() rejects.
+ */
+int binary2(int op, int r, int type, int n, char *s, int m, char *t, int l, char *u) {
+  int k;
+  int j = 0;
   promote(type);
-  emit(n, s);
-  stack_pos = stack_pos - 1;
+  if (const_pos == codepos) {
+    k = load_int(code + codepos - 4);
+    codepos = codepos - be_const_size(codepos) - 1;
+    if (r & 1)
+      codepos = codepos - 1 - x64;
+    if ((r >> 1) & (((op != '<') & (op != '>')) | ((0 <= k) & (k <= 31))))
+      j = fold_fits(op, load_int(code + codepos - 4), k);
+    if (j) {
+      j = load_int(code + codepos - 4);
+      codepos = codepos - be_const_size(codepos);
+      be_const(fold(op, j, k));
+      var_pos = 0;
+      if ((r & 1) == 0)
+        stack_pos = stack_pos - 1;
+      return 3;
+    }
+    emit(l, u);
+    while (u[j] != '.')
+      j = j + 1;
+    save_int(code + codepos - l + j, k);
+    const_pos = 0;
+    var_pos = 0;
+  }
+  else if (r & 1)
+    emit(m, t);
+  else
+    emit(n, s);
+  if ((r & 1) == 0)
+    stack_pos = stack_pos - 1;
+  if ((op == 'l') | (op == '=') | (op == '!'))
+    cmp_pos = codepos;
   return 3;
 }
 
@@ -426,8 +1147,11 @@ int binary2(int type, int n, char *s) {
 int postfix_expr() {
   int type = primary_expr();
   if (accept("[")) {
-    binary1(type); /* pop %ebx ; add %ebx,%eax */
-    binary2(expression(), 3, "\x5b\x01\xd8");
+    int r = binary1(type); /* pop %ebx ; add %ebx,%eax */
+    if (x64)
+      binary2('+', r, expression(), 4, "\x5b\x48\x01\xd8", 3, "\x48\x01\xc8", 6, "\x48\x05....");
+    else
+      binary2('+', r, expression(), 3, "\x5b\x01\xd8", 2, "\x01\xc8", 5, "\x05....");
     expect("]");
     type = 1;
   }
@@ -446,8 +1170,11 @@ int postfix_expr() {
       }
       expect(")");
     }
-    emit(7, "\x8b\x84\x24...."); /* mov (n * 4)(%esp),%eax */
-    save_int(code + codepos - 4, (stack_pos - s - 1) << 2);
+    if (x64)
+      emit(8, "\x48\x8b\x84\x24...."); /* mov (n * 8)(%rsp),%rax */
+    else
+      emit(7, "\x8b\x84\x24...."); /* mov (n * 4)(%esp),%eax */
+    save_int(code + codepos - 4, (stack_pos - s - 1) << (2 + x64));
     emit(2, "\xff\xd0"); /* call *%eax */
     be_pop(stack_pos - s);
     stack_pos = s;
@@ -466,12 +1193,18 @@ int additive_expr() {
   int type = postfix_expr();
   while (1) {
     if (accept("+")) {
-      binary1(type); /* pop %ebx ; add %ebx,%eax */
-      type = binary2(postfix_expr(), 3, "\x5b\x01\xd8");
+      int r = binary1(type); /* pop %ebx ; add %ebx,%eax */
+      if (x64)
+        type = binary2('+', r, postfix_expr(), 4, "\x5b\x48\x01\xd8", 3, "\x48\x01\xc8", 6, "\x48\x05....");
+      else
+        type = binary2('+', r, postfix_expr(), 3, "\x5b\x01\xd8", 2, "\x01\xc8", 5, "\x05....");
     }
     else if (accept("-")) {
-      binary1(type); /* pop %ebx ; sub %eax,%ebx ; mov %ebx,%eax */
-      type = binary2(postfix_expr(), 5, "\x5b\x29\xc3\x89\xd8");
+      int r = binary1(type); /* pop %ebx ; sub %eax,%ebx ; mov %ebx,%eax */
+      if (x64)
+        type = binary2('-', r, postfix_expr(), 7, "\x5b\x48\x29\xc3\x48\x89\xd8", 6, "\x48\x29\xc1\x48\x89\xc8", 6, "\x48\x2d....");
+      else
+        type = binary2('-', r, postfix_expr(), 5, "\x5b\x29\xc3\x89\xd8", 4, "\x29\xc1\x89\xc8", 5, "\x2d....");
     }
     else
       return type;
@@ -488,12 +1221,18 @@ int shift_expr() {
   int type = additive_expr();
   while (1) {
     if (accept("<<")) {
-      binary1(type); /* mov %eax,%ecx ; pop %eax ; shl %cl,%eax */
-      type = binary2(additive_expr(), 5, "\x89\xc1\x58\xd3\xe0");
+      int r = binary1(type); /* mov %eax,%ecx ; pop %eax ; shl %cl,%eax */
+      if (x64)
+        type = binary2('<', r, additive_expr(), 7, "\x48\x89\xc1\x58\x48\xd3\xe0", 5, "\x48\x91\x48\xd3\xe0", 8, "\xb9....\x48\xd3\xe0");
+      else
+        type = binary2('<', r, additive_expr(), 5, "\x89\xc1\x58\xd3\xe0", 3, "\x91\xd3\xe0", 7, "\xb9....\xd3\xe0");
     }
     else if (accept(">>")) {
-      binary1(type); /* mov %eax,%ecx ; pop %eax ; sar %cl,%eax */
-      type = binary2(additive_expr(), 5, "\x89\xc1\x58\xd3\xf8");
+      int r = binary1(type); /* mov %eax,%ecx ; pop %eax ; sar %cl,%eax */
+      if (x64)
+        type = binary2('>', r, additive_expr(), 7, "\x48\x89\xc1\x58\x48\xd3\xf8", 5, "\x48\x91\x48\xd3\xf8", 8, "\xb9....\x48\xd3\xf8");
+      else
+        type = binary2('>', r, additive_expr(), 5, "\x89\xc1\x58\xd3\xf8", 3, "\x91\xd3\xf8", 7, "\xb9....\xd3\xf8");
     }
     else
       return type;
@@ -508,10 +1247,18 @@ int shift_expr() {
 int relational_expr() {
   int type = shift_expr();
   while (accept("<=")) {
-    binary1(type);
+    int r = binary1(type);
     /* pop %ebx ; cmp %eax,%ebx ; setle %al ; movzbl %al,%eax */
-    type = binary2(shift_expr(),
-                   9, "\x5b\x39\xc3\x0f\x9e\xc0\x0f\xb6\xc0");
+    if (x64)
+      type = binary2('l', r, shift_expr(),
+                     10, "\x5b\x48\x39\xc3\x0f\x9e\xc0\x0f\xb6\xc0",
+                     9, "\x48\x39\xc1\x0f\x9e\xc0\x0f\xb6\xc0",
+                     12, "\x48\x3d....\x0f\x9e\xc0\x0f\xb6\xc0");
+    else
+      type = binary2('l', r, shift_expr(),
+                     9, "\x5b\x39\xc3\x0f\x9e\xc0\x0f\xb6\xc0",
+                     8, "\x39\xc1\x0f\x9e\xc0\x0f\xb6\xc0",
+                     11, "\x3d....\x0f\x9e\xc0\x0f\xb6\xc0");
   }
   return type;
 }
@@ -526,16 +1273,32 @@ int equality_expr() {
   int type = relational_expr();
   while (1) {
     if (accept("==")) {
-      binary1(type);
+      int r = binary1(type);
       /* pop %ebx ; cmp %eax,%ebx ; sete %al ; movzbl %al,%eax */
-      type = binary2(relational_expr(),
-                     9, "\x5b\x39\xc3\x0f\x94\xc0\x0f\xb6\xc0");
+      if (x64)
+        type = binary2('=', r, relational_expr(),
+                       10, "\x5b\x48\x39\xc3\x0f\x94\xc0\x0f\xb6\xc0",
+                       9, "\x48\x39\xc1\x0f\x94\xc0\x0f\xb6\xc0",
+                       12, "\x48\x3d....\x0f\x94\xc0\x0f\xb6\xc0");
+      else
+        type = binary2('=', r, relational_expr(),
+                       9, "\x5b\x39\xc3\x0f\x94\xc0\x0f\xb6\xc0",
+                       8, "\x39\xc1\x0f\x94\xc0\x0f\xb6\xc0",
+                       11, "\x3d....\x0f\x94\xc0\x0f\xb6\xc0");
     }
     else if (accept("!=")) {
-      binary1(type);
+      int r = binary1(type);
       /* pop %ebx ; cmp %eax,%ebx ; setne %al ; movzbl %al,%eax */
-      type = binary2(relational_expr(),
-                     9, "\x5b\x39\xc3\x0f\x95\xc0\x0f\xb6\xc0");
+      if (x64)
+        type = binary2('!', r, relational_expr(),
+                       10, "\x5b\x48\x39\xc3\x0f\x95\xc0\x0f\xb6\xc0",
+                       9, "\x48\x39\xc1\x0f\x95\xc0\x0f\xb6\xc0",
+                       12, "\x48\x3d....\x0f\x95\xc0\x0f\xb6\xc0");
+      else
+        type = binary2('!', r, relational_expr(),
+                       9, "\x5b\x39\xc3\x0f\x95\xc0\x0f\xb6\xc0",
+                       8, "\x39\xc1\x0f\x95\xc0\x0f\xb6\xc0",
+                       11, "\x3d....\x0f\x95\xc0\x0f\xb6\xc0");
     }
     else
       return type;
@@ -550,8 +1313,11 @@ int equality_expr() {
 int bitwise_and_expr() {
   int type = equality_expr();
   while (accept("&")) {
-    binary1(type); /* pop %ebx ; and %ebx,%eax */
-    type = binary2(equality_expr(), 3, "\x5b\x21\xd8");
+    int r = binary1(type); /* pop %ebx ; and %ebx,%eax */
+    if (x64)
+      type = binary2('&', r, equality_expr(), 4, "\x5b\x48\x21\xd8", 3, "\x48\x21\xc8", 6, "\x48\x25....");
+    else
+      type = binary2('&', r, equality_expr(), 3, "\x5b\x21\xd8", 2, "\x21\xc8", 5, "\x25....");
   }
   return type;
 }
@@ -564,8 +1330,11 @@ int bitwise_and_expr() {
 int bitwise_or_expr() {
   int type = bitwise_and_expr();
   while (accept("|")) {
-    binary1(type); /* pop %ebx ; or %ebx,%eax */
-    type = binary2(bitwise_and_expr(), 3, "\x5b\x09\xd8");
+    int r = binary1(type); /* pop %ebx ; or %ebx,%eax */
+    if (x64)
+      type = binary2('|', r, bitwise_and_expr(), 4, "\x5b\x48\x09\xd8", 3, "\x48\x09\xc8", 6, "\x48\x0d....");
+    else
+      type = binary2('|', r, bitwise_and_expr(), 3, "\x5b\x09\xd8", 2, "\x09\xc8", 5, "\x0d....");
   }
   return type;
 }
@@ -578,14 +1347,22 @@ int bitwise_or_expr() {
 int expression() {
   int type = bitwise_or_expr();
   if (accept("=")) {
-    be_push();
-    stack_pos = stack_pos + 1;
+    int r = binary1(3) & 1;
     promote(expression());
-    if (type == 2)
-      emit(3, "\x5b\x89\x03"); /* pop %ebx ; mov %eax,(%ebx) */
+    if (r == 0) {
+      emit(1, "\x5b"); /* pop %ebx */
+      stack_pos = stack_pos - 1;
+    }
+    if (type == 1)
+      emit(1, "\x88"); /* mov %al,... */
+    else if (x64)
+      emit(2, "\x48\x89"); /* mov %rax,... */
     else
-      emit(3, "\x5b\x88\x03"); /* pop %ebx ; mov %al,(%ebx) */
-    stack_pos = stack_pos - 1;
+      emit(1, "\x89"); /* mov %eax,... */
+    if (r)
+      emit(1, "\x01"); /* (%ecx) */
+    else
+      emit(1, "\x03"); /* (%ebx) */
     type = 3;
   }
   return type;
@@ -621,7 +1398,7 @@ void statement() {
     int s = stack_pos;
     while (accept("}") == 0)
       statement();
-    table_pos = n;
+    sym_rewind(n);
     be_pop(stack_pos - s);
     stack_pos = s;
   }
@@ -638,10 +1415,11 @@ void statement() {
   else if (accept("if")) {
     expect("(");
     promote(expression());
-    emit(8, "\x85\xc0\x0f\x84...."); /* test %eax,%eax ; je ... */
+    be_branch();
     p1 = codepos;
     expect(")");
     statement();
+    be_mark('j');
     emit(5, "\xe9...."); /* jmp ... */
     p2 = codepos;
     save_int(code + p1 - 4, codepos - p1);
@@ -653,10 +1431,11 @@ void statement() {
     expect("(");
     p1 = codepos;
     promote(expression());
-    emit(8, "\x85\xc0\x0f\x84...."); /* test %eax,%eax ; je ... */
+    be_branch();
     p2 = codepos;
     expect(")");
     statement();
+    be_mark('j');
     emit(5, "\xe9...."); /* jmp ... */
     save_int(code + codepos - 4, p1 - codepos);
     save_int(code + p2 - 4, codepos - p2);
@@ -666,6 +1445,7 @@ void statement() {
       promote(expression());
     expect(";");
     be_pop(stack_pos);
+    be_mark('r');
     emit(1, "\xc3"); /* ret */
   }
   else {
@@ -698,8 +1478,8 @@ void program() {
     current_symbol = sym_declare_global(token);
     get_token();
     if (accept(";")) {
-      sym_define_global(current_symbol);
-      emit(4, "\x00\x00\x00\x00");
+      sym_define(current_symbol, data_offset + data_pos);
+      data_pos = data_pos + (4 << x64);
     }
     else if (accept("(")) {
       int n = table_pos;
@@ -715,18 +1495,36 @@ void program() {
       }
       if (accept(";") == 0) {
         sym_define_global(current_symbol);
+        fn_start = codepos;
         statement();
+        be_mark('r');
         emit(1, "\xc3"); /* ret */
+        be_peephole();
       }
-      table_pos = n;
+      sym_rewind(n);
     }
     else
       error();
   }
 }
 
-int compile() {
+/* Any argument, e.g. -m64, selects x86-64 output. */
+int compile(int argc) {
+  if (2 <= argc)
+    x64 = 1;
+  buckets = malloc(4096);
+  str_buckets = malloc(4096);
+  i = 0;
+  while (i <= 4095) {
+    buckets[i] = 0;
+    str_buckets[i] = 0;
+    i = i + 1;
+  }
   code_offset = 134512640; /* 0x08048000 */
+  if (x64)
+    code_offset = 4194304; /* 0x400000 */
+  data_offset = 536870912; /* 0x20000000 */
+  data_pos = 65536; /* getchar buffer */
   be_start();
   nextc = getchar();
   get_token();
@@ -4,6 +4,8 @@
 
 #include <iostream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 using namespace std;
 
@@ -13,6 +15,22 @@ void indent(int n) {
   for (int i = 0; i < n; ++i) cout << "    ";
 }
 
+class Atom { // interned names: equal names get equal ids
+private:
+  static unordered_map<string, int> ids;
+  static vector<string> names;
+public:
+  static int Intern(const string &name) {
+    auto it = ids.emplace(name, (int) names.size()).first;
+    if (it->second == (int) names.size()) names.push_back(name);
+    return it->second;
+  }
+  static const string &Name(int id) { return names[id]; }
+};
+
+unordered_map<string, int> Atom::ids;
+vector<string> Atom::names;
+
 class CompoundTerm;
 
 class Term {
@@ -25,16 +43,16 @@ public:
 
 class CompoundTerm : public Term {
 private:
-    string fsym;
+    long long fsym; // atom id << 32 | arity: one compare checks both
     int arity;
     Term **args;
 public:
-  CompoundTerm(const string &f) : fsym(f), arity(0), args(NULL) {}
-  CompoundTerm(const string &f, Term *a1) : fsym(f), arity(1), args(new Term*[1]) { args[0] = a1; };
-  CompoundTerm(const string &f, Term *a1, Term *a2) : fsym(f), arity(2), args(new Term*[2]) { args[0] = a1, args[1] = a2; };
-  CompoundTerm(const string &f, Term *a1, Term *a2, Term *a3) : fsym(f), arity(3), args(new Term*[3]) { args[0] = a1, args[1] = a2, args[2] = a3; };
+  CompoundTerm(const string &f) : fsym((long long) Atom::Intern(f) << 32), arity(0), args(NULL) {}
+  CompoundTerm(const string &f, Term *a1) : fsym((long long) Atom::Intern(f) << 32 | 1), arity(1), args(new Term*[1]) { args[0] = a1; };
+  CompoundTerm(const string &f, Term *a1, Term *a2) : fsym((long long) Atom::Intern(f) << 32 | 2), arity(2), args(new Term*[2]) { args[0] = a1, args[1] = a2; };
+  CompoundTerm(const string &f, Term *a1, Term *a2, Term *a3) : fsym((long long) Atom::Intern(f) << 32 | 3), arity(3), args(new Term*[3]) { args[0] = a1, args[1] = a2, args[2] = a3; };
   void print() {
-    cout << fsym;
+    cout << Atom::Name(fsym >> 32);
     if (arity > 0) {
       cout << "(";
       for (int i = 0; i < arity; ) {
@@ -54,7 +72,7 @@ private:
       args[i] = other->args[i]->copy();
   }
   bool unify2(CompoundTerm *other) { 
-    if (!(fsym == other->fsym && arity == other->arity))
+    if (fsym != other->fsym)
       return false;
     for (int i = 0; i < arity; i++)
       if (!args[i]->unify(other->args[i]))
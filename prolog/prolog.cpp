@@ -1,7 +1,12 @@
 #include <cassert>
 #include <cstring>
+#include <initializer_list>
 #include <iostream>
 #include <list>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 using namespace std;
 
@@ -11,15 +16,31 @@ void indent(unsigned int n) {
   for (unsigned int i = 0; i < n; ++i) cout << "    ";
 }
 
+class Atom { // interned names: equal names get equal ids
+private: // statics
+  static unordered_map<string, unsigned int> ids;
+  static vector<string> names;
+public: // statics
+  static unsigned int Intern(const char *name) {
+    auto it = ids.emplace(name, names.size()).first;
+    if (it->second == names.size()) names.push_back(it->first);
+    return it->second;
+  }
+  static const string &Name(unsigned int id) { return names[id]; }
+};
+
+unordered_map<string, unsigned int> Atom::ids;
+vector<string> Atom::names;
+
 class CompoundTerm;
 class Variable;
 
 class Term {
 public: // statics
-  static void Print(const list<Term*> &l, const char *s) {
-    for (auto it = l.begin();;) {
-      (*it)->print();
-      if (++it == l.end()) break;
+  static void Print(Term *const *a, unsigned int n, const char *s) {
+    for (unsigned int i = 0;;) {
+      a[i]->print();
+      if (++i == n) break;
       cout << s;
     }
   }
@@ -28,32 +49,46 @@ public:
   virtual bool unify(Term *t) = 0;
   virtual bool unifyCompoundTerm(CompoundTerm *ct) { return false; }
   virtual bool unifyVariable(Variable *v) { return false; }
+  virtual CompoundTerm *getCompoundTerm() { return NULL; } // bound variables are followed
 };
 
 class CompoundTerm: public Term { // functor(arg0, arg1 ... argN).
+public: // statics
+  // the arguments are stored inline behind the term, one allocation per term
+  static CompoundTerm *Make(const char *f, initializer_list<Term*> args = {}) {
+    void *m = operator new(sizeof (CompoundTerm) + args.size() * sizeof (Term*));
+    return new (m) CompoundTerm(f, args);
+  }
 private:
-  const char *functor;
-  unsigned int arity;
-  list<Term*> args;
+  unsigned long long functor; // atom id << 32 | arity: one compare checks both
+  CompoundTerm(const char *f, initializer_list<Term*> a): functor((unsigned long long) Atom::Intern(f) << 32 | a.size()) {
+    Term **arg = args();
+    for (auto it = a.begin(); it != a.end(); ++it)
+      *arg++ = *it;
+  }
+  Term **args() { return reinterpret_cast<Term**>(this + 1); }
+  Term *const *args() const { return reinterpret_cast<Term *const *>(this + 1); }
 public:
-  CompoundTerm(const char *f): functor(f), arity(0) {}
-  void addArg(Term *arg) { args.push_back(arg); ++arity; }
+  unsigned long long getFunctor() const { return functor; }
+  unsigned int getArity() const { return (unsigned int) functor; }
+  Term *getFirstArg() const { return args()[0]; }
   void print() const {
-    cout << functor;
-    if (!args.empty()) {
+    cout << Atom::Name(functor >> 32);
+    if (getArity() > 0) {
       cout << "(";
-      Term::Print(args, ", ");
+      Term::Print(args(), getArity(), ", ");
       cout << ")";
     }
   };
   bool unify(Term *t) { return t->unifyCompoundTerm(this); }
+  CompoundTerm *getCompoundTerm() { return this; }
   bool unifyCompoundTerm(CompoundTerm *ct) {
-    if (functor != ct->functor || arity != ct->arity)
+    if (functor != ct->functor)
       return false;
-    auto it1 = args.begin();
-    auto it2 = ct->args.begin();
-    for (unsigned int i = 0; i < arity; ++i)
-      if (!(*it1++)->unify(*it2++))
+    Term **a1 = args();
+    Term **a2 = ct->args();
+    for (unsigned int i = 0; i < getArity(); ++i)
+      if (!a1[i]->unify(a2[i]))
         return false;
     return true;
   }
@@ -62,15 +97,13 @@ public:
 class Variable: public Term {
 private: // statics
   static unsigned int count;
-  static list<Variable*> trail;
+  static vector<Variable*> trail; // bound variables, most recent last
 public: // statics
-  static Variable *GetTrailhead() { return trail.front(); }
-  static void Rewind(Variable *to) {
-    Variable *v = trail.front();
-    while (v != to) {
-      v->reset();
-      trail.pop_front();
-      v = trail.front();
+  static size_t GetTrailMark() { return trail.size(); }
+  static void Rewind(size_t mark) {
+    while (trail.size() > mark) {
+      trail.back()->reset();
+      trail.pop_back();
     }
   }
 private:
@@ -90,57 +123,130 @@ public:
   bool unify(Term *t) {
     if (term != NULL)
       return term->unify(t);
-    trail.push_front(this);
+    trail.push_back(this);
     term = t;
     return true;
   }
   bool unifyCompoundTerm(CompoundTerm *ct) { return unify(ct); }
   bool unifyVariable(Variable *v) { return unify(v); }
+  CompoundTerm *getCompoundTerm() { return term != NULL ? term->getCompoundTerm() : NULL; }
   void reset() { term = NULL; }
 };
 
 unsigned int Variable::count = 0;
-list<Variable*> Variable::trail;
+vector<Variable*> Variable::trail;
+
+class Goal { // goals of a clause body, linked in order
+public:
+  Term *term;
+  Goal *next;
+  Goal(Term *t): term(t), next(NULL) {}
+};
+
+class Continuation { // goals still to solve: the rest of a clause body, then the continuation of the caller (shared)
+public:
+  const Goal *goals;
+  const Continuation *next;
+  Continuation(const Goal *g, const Continuation *n): goals(g), next(n) {}
+};
 
 class Clause { // head :- body
 private:
   Term *head;
-  list<Term*> body; // empty for facts
+  Goal *body; // NULL for facts
+  Goal **last;
 public:
-  Clause(Term *h) : head(h) {}
+  Clause(Term *h) : head(h), body(NULL), last(&body) {}
   Term *getHead() const { return head; }
-  list<Term*> &getBody() { return body; }
-  void addGoal(Term *t) { body.push_back(t); }
+  const Goal *getBody() const { return body; }
+  void addGoal(Term *t) { *last = new Goal(t); last = &(*last)->next; }
   void print() const {
     head->print();
     cout << " :- ";
-    if (body.empty())
+    if (body == NULL)
       cout << "true";
-    else
-      Term::Print(body, ", ");
+    for (const Goal *g = body; g != NULL; g = g->next) {
+      g->term->print();
+      if (g->next != NULL) cout << ", ";
+    }
+  }
+};
+
+class Predicate { // clauses of one functor/arity in program order, indexed on the first argument
+private:
+  vector<Clause*> clauses;
+  vector<Clause*> varFirst; // clauses with a variable as first argument
+  unordered_map<unsigned long long, vector<Clause*>> byFirst; // clauses with a first argument of the functor, and those of varFirst
+public:
+  void addClause(Clause *c) {
+    clauses.push_back(c);
+    CompoundTerm *head = c->getHead()->getCompoundTerm();
+    if (head->getArity() == 0)
+      return;
+    CompoundTerm *first = head->getFirstArg()->getCompoundTerm();
+    if (first == NULL) { // candidate for any first argument
+      varFirst.push_back(c);
+      for (auto it = byFirst.begin(); it != byFirst.end(); ++it)
+        it->second.push_back(c);
+    }
+    else {
+      auto it = byFirst.find(first->getFunctor());
+      if (it == byFirst.end())
+        it = byFirst.emplace(first->getFunctor(), varFirst).first;
+      it->second.push_back(c);
+    }
+  }
+  // clauses whose head may unify with goal
+  const vector<Clause*> &getCandidates(CompoundTerm *goal) const {
+    if (goal->getArity() == 0)
+      return clauses;
+    CompoundTerm *first = goal->getFirstArg()->getCompoundTerm();
+    if (first == NULL)
+      return clauses;
+    auto it = byFirst.find(first->getFunctor());
+    return it != byFirst.end() ? it->second : varFirst;
   }
 };
 
 class Program {
 private:
-  list<Clause*> clauses;
+  vector<Clause*> clauses; // in program order
+  unordered_map<unsigned long long, Predicate> predicates; // by functor
 public:
-  void addClause(Clause *c) { clauses.push_back(c); }
-  int solve(list<Term*> &ql, list<Variable*> &vl, unsigned int level = 0) {
+  void addClause(Clause *c) {
+    clauses.push_back(c);
+    CompoundTerm *head = c->getHead()->getCompoundTerm();
+    assert(head != NULL);
+    predicates[head->getFunctor()].addClause(c);
+  }
+  // clauses whose head may unify with q
+  const vector<Clause*> &getCandidates(Term *q) const {
+    static const vector<Clause*> none;
+    CompoundTerm *goal = q->getCompoundTerm();
+    if (goal == NULL)
+      return clauses;
+    auto it = predicates.find(goal->getFunctor());
+    return it != predicates.end() ? it->second.getCandidates(goal) : none;
+  }
+  // solve the first goal of k, then the rest; the continuations live on the stack of the recursion
+  int solve(const Continuation *k, list<Variable*> &vl, unsigned int level = 0) {
     int solved = 0;
-    Term *q = ql.front();
-    ql.pop_front();
+    Term *q = k->goals->term;
+    Continuation rest(k->goals->next, k->next);
     if (debug) { indent(level); cout << "solve@"  << level << ": "; q->print(); cout << endl; }
-    for (auto it = clauses.begin(); it != clauses.end(); ++it) {
-      auto trailhead = Variable::GetTrailhead();
+    const vector<Clause*> &candidates = getCandidates(q);
+    for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+      size_t mark = Variable::GetTrailMark();
       Clause *c = (*it);
       Term *head = c->getHead();
       if (debug) { indent(level); cout << "  try: "; c->print(); cout << endl; }
       if (q->unify(head)) {
         if (debug) { indent(level); cout << "  MATCH" << endl; }
-        list<Term*> goals(c->getBody()); // copy goals from clause
-        goals.insert(goals.end(), ql.begin(), ql.end()); // append ql to goals
-        if (goals.empty()) {
+        Continuation body(c->getBody(), &rest); // clause body, then the rest of k
+        const Continuation *goals = &body;
+        while (goals != NULL && goals->goals == NULL) // skip solved bodies
+          goals = goals->next;
+        if (goals == NULL) {
           ++solved;
           if (!vl.empty()) {
             for (auto it = vl.begin(); it != vl.end(); ++it) {
@@ -159,7 +265,7 @@ public:
       else {
         if (debug) { indent(level); cout << "  no match" << endl; }
       }
-      Variable::Rewind(trailhead);
+      Variable::Rewind(mark);
     }
     if (level == 0) {
       if (solved) {
@@ -173,9 +279,9 @@ public:
     return solved;
   }
   int solve(Term *q, list<Variable*> &vl) {
-    list<Term*> ql;
-    ql.push_back(q);
-    return solve(ql, vl);
+    Goal g(q);
+    Continuation k(&g, NULL);
+    return solve(&k, vl);
   }
 };
 
@@ -191,14 +297,14 @@ public:
 // name: (printable)+ | '\'' (printable | whitespcae)+ '\''.
 
 void sample_test_program() {
-  Term *tGerd = new CompoundTerm("Gerd");
-  Term *tLaura = new CompoundTerm("Laura");
-  Term *tKarlHeinz = new CompoundTerm("Karl-Heinz");
-  Term *tDoris = new CompoundTerm("Doris");
-  Term *tMike = new CompoundTerm("Mike");
-  Term *tNicki = new CompoundTerm("Nicki");
-  Term *tNico = new CompoundTerm("Nico");
-  Term *tLuca = new CompoundTerm("Luca");
+  Term *tGerd = CompoundTerm::Make("Gerd");
+  Term *tLaura = CompoundTerm::Make("Laura");
+  Term *tKarlHeinz = CompoundTerm::Make("Karl-Heinz");
+  Term *tDoris = CompoundTerm::Make("Doris");
+  Term *tMike = CompoundTerm::Make("Mike");
+  Term *tNicki = CompoundTerm::Make("Nicki");
+  Term *tNico = CompoundTerm::Make("Nico");
+  Term *tLuca = CompoundTerm::Make("Luca");
   const char *aGrandchildGrandparent = "grandchild-grandparent";
   const char *aChildParent = "child-parent";
   const char *aGrandchild = "grandchild";
@@ -216,35 +322,35 @@ void sample_test_program() {
   // Facts:
 
   // child-parent(Mike, Gerd).
-  ct = new CompoundTerm(aChildParent); ct->addArg(tMike); ct->addArg(tGerd);
+  ct = CompoundTerm::Make(aChildParent, {tMike, tGerd});
   p->addClause(new Clause(ct));
 
   // child-parent(Mike, Laura).
-  ct = new CompoundTerm(aChildParent); ct->addArg(tMike); ct->addArg(tLaura);
+  ct = CompoundTerm::Make(aChildParent, {tMike, tLaura});
   p->addClause(new Clause(ct));
 
   // child-parent(Nicki, Karl-Heinz).
-  ct = new CompoundTerm(aChildParent); ct->addArg(tNicki); ct->addArg(tKarlHeinz);
+  ct = CompoundTerm::Make(aChildParent, {tNicki, tKarlHeinz});
   p->addClause(new Clause(ct));
 
   // child-parent(Nicki, Doris).
-  ct = new CompoundTerm(aChildParent); ct->addArg(tNicki); ct->addArg(tDoris);
+  ct = CompoundTerm::Make(aChildParent, {tNicki, tDoris});
   p->addClause(new Clause(ct));
 
   // child-parent(Nico, Mike).
-  ct = new CompoundTerm(aChildParent); ct->addArg(tNico); ct->addArg(tMike);
+  ct = CompoundTerm::Make(aChildParent, {tNico, tMike});
   p->addClause(new Clause(ct));
 
   // child-parent(Luca, Mike).
-  ct = new CompoundTerm(aChildParent); ct->addArg(tLuca); ct->addArg(tMike);
+  ct = CompoundTerm::Make(aChildParent, {tLuca, tMike});
   p->addClause(new Clause(ct));
 
   // child-parent(Nico, Nicki).
-  ct = new CompoundTerm(aChildParent); ct->addArg(tNico); ct->addArg(tNicki);
+  ct = CompoundTerm::Make(aChildParent, {tNico, tNicki});
   p->addClause(new Clause(ct));
 
   // child-parent(Luca, Nicki).
-  ct = new CompoundTerm(aChildParent); ct->addArg(tLuca); ct->addArg(tNicki);
+  ct = CompoundTerm::Make(aChildParent, {tLuca, tNicki});
   p->addClause(new Clause(ct));
 
   // Rules:
@@ -253,11 +359,11 @@ void sample_test_program() {
   v1 = new Variable(aGrandchild);
   v2 = new Variable(aGrandparent);
   v3 = new Variable(aX);
-  ct = new CompoundTerm(aGrandchildGrandparent); ct->addArg(v1); ct->addArg(v2);
+  ct = CompoundTerm::Make(aGrandchildGrandparent, {v1, v2});
   c = new Clause(ct);
-  ct = new CompoundTerm(aChildParent); ct->addArg(v1); ct->addArg(v3);
+  ct = CompoundTerm::Make(aChildParent, {v1, v3});
   c->addGoal(ct);
-  ct = new CompoundTerm(aChildParent); ct->addArg(v3); ct->addArg(v2);
+  ct = CompoundTerm::Make(aChildParent, {v3, v2});
   c->addGoal(ct);
   p->addClause(c);
 
@@ -266,42 +372,42 @@ void sample_test_program() {
   vl.clear();
   cout << "?- child-parent(?child, Nicki)." << endl;
   v1 = new Variable(aChild); vl.push_back(v1);
-  ct = new CompoundTerm(aChildParent); ct->addArg(v1); ct->addArg(tNicki);
+  ct = CompoundTerm::Make(aChildParent, {v1, tNicki});
   p->solve(ct, vl);
 
   vl.clear();
   cout << "\n?- child-parent(?child, Luca)." << endl;
   v1 = new Variable(aChild); vl.push_back(v1);
-  ct = new CompoundTerm(aChildParent); ct->addArg(v1); ct->addArg(tLuca);
+  ct = CompoundTerm::Make(aChildParent, {v1, tLuca});
   p->solve(ct, vl);
 
   vl.clear();
   cout << "\n?- child-parent(?child, ?parent)." << endl;
   v1 = new Variable(aChild); vl.push_back(v1);
   v2 = new Variable(aParent); vl.push_back(v2);
-  ct = new CompoundTerm(aChildParent); ct->addArg(v1); ct->addArg(v2);
+  ct = CompoundTerm::Make(aChildParent, {v1, v2});
   p->solve(ct, vl);
 
   cout << "\n?- child-parent(Nico, Mike)." << endl;
   vl.clear();
-  ct = new CompoundTerm(aChildParent); ct->addArg(tNico); ct->addArg(tMike);
+  ct = CompoundTerm::Make(aChildParent, {tNico, tMike});
   p->solve(ct, vl);
 
   cout << "\n?- child-parent(Luca, Gerd)." << endl;
   vl.clear();
-  ct = new CompoundTerm(aChildParent); ct->addArg(tLuca); ct->addArg(tGerd);
+  ct = CompoundTerm::Make(aChildParent, {tLuca, tGerd});
   p->solve(ct, vl);
 
   cout << "\n?- grandchild-grandparent(Luca, Gerd)." << endl;
   vl.clear();
-  ct = new CompoundTerm(aGrandchildGrandparent); ct->addArg(tLuca); ct->addArg(tGerd);
+  ct = CompoundTerm::Make(aGrandchildGrandparent, {tLuca, tGerd});
   p->solve(ct, vl);
 
   vl.clear();
   cout << "\n?- grandchild-grandparent(?grandchild, ?grandparent)." << endl;
   v1 = new Variable(aGrandchild); vl.push_back(v1);
   v2 = new Variable(aGrandparent); vl.push_back(v2);
-  ct = new CompoundTerm(aGrandchildGrandparent); ct->addArg(v1); ct->addArg(v2);
+  ct = CompoundTerm::Make(aGrandchildGrandparent, {v1, v2});
   p->solve(ct, vl);
 }
 